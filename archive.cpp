@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "archive.hpp"
+
+using namespace std;
+
+#define ARCHIVE_MAGIC "CHESSGA1"
+#define ARCHIVE_FOOTER_SIZE 24
+
+static const char* results[] = {"*", "1-0", "0-1", "1/2-1/2"};
+
+vector<EncMove> archiveMoveOrder(Board& board) {
+    vector<EncMove> moves = board.generateLegalMoves(board.getSide());
+    sort(moves.begin(), moves.end());
+    return moves;
+}
+
+static void putLittleEndian(unsigned char* out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) out[i] = (value >> (8 * i)) & 0xFF;
+}
+
+static uint64_t getLittleEndian(const unsigned char* in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) value |= static_cast<uint64_t>(in[i]) << (8 * i);
+    return value;
+}
+
+ArchiveWriter::ArchiveWriter(): file{nullptr}, offsets{}, written{0}, board{} {}
+
+ArchiveWriter::~ArchiveWriter() {
+    close();
+}
+
+bool ArchiveWriter::open(const string& path) {
+    close();
+    file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+    offsets.clear();
+    written = 0;
+    put(ARCHIVE_MAGIC, 8);
+    return true;
+}
+
+void ArchiveWriter::put(const void* bytes, size_t length) {
+    written += fwrite(bytes, 1, length, file);
+}
+
+void ArchiveWriter::putString(const string& text) {
+    unsigned char length[2];
+    putLittleEndian(length, min<size_t>(text.size(), 0xFFFF), 2);
+    put(length, 2);
+    put(text.data(), min<size_t>(text.size(), 0xFFFF));
+}
+
+bool ArchiveWriter::write(const PgnGame& game) {
+    if (!file) return false;
+    // moves are indexed before anything is written, so a bad game leaves no trace
+    string fen = game.fen.empty() || game.fen == DEFAULT_FEN ? "" : game.fen;
+    if (!fen.empty() && !Board::isValidFen(fen)) return false;
+    board.reset(fen.empty() ? DEFAULT_FEN : fen);
+    vector<unsigned char> plies;
+    plies.reserve(game.moves.size());
+    for (EncMove move : game.moves) {
+        vector<EncMove> order = archiveMoveOrder(board);
+        auto found = lower_bound(order.begin(), order.end(), move);
+        if (found == order.end() || *found != move) return false;
+        plies.push_back(static_cast<unsigned char>(found - order.begin()));
+        board.makeMove(move);
+    }
+
+    offsets.push_back(written);
+    unsigned char buffer[4];
+    putLittleEndian(buffer, min<size_t>(game.tags.size(), 0xFFFF), 2);
+    put(buffer, 2);
+    for (size_t i = 0; i < game.tags.size() && i < 0xFFFF; ++i) {
+        putString(game.tags[i].first);
+        putString(game.tags[i].second);
+    }
+    putString(fen);
+    unsigned char result = 0;
+    for (unsigned char code = 0; code < 4; ++code) {
+        if (game.result == results[code]) result = code;
+    }
+    put(&result, 1);
+    putLittleEndian(buffer, plies.size(), 4);
+    put(buffer, 4);
+    if (!plies.empty()) put(plies.data(), plies.size());
+    return true;
+}
+
+bool ArchiveWriter::close() {
+    if (!file) return true;
+    uint64_t indexOffset = written;
+    unsigned char buffer[8];
+    for (uint64_t offset : offsets) {
+        putLittleEndian(buffer, offset, 8);
+        put(buffer, 8);
+    }
+    putLittleEndian(buffer, offsets.size(), 8);
+    put(buffer, 8);
+    putLittleEndian(buffer, indexOffset, 8);
+    put(buffer, 8);
+    put(ARCHIVE_MAGIC, 8);
+    bool ok = !ferror(file) && written == indexOffset + 8 * offsets.size() + ARCHIVE_FOOTER_SIZE;
+    ok = fclose(file) == 0 && ok;
+    file = nullptr;
+    return ok;
+}
+
+ArchiveReader::ArchiveReader(): data{nullptr}, size{0}, index{nullptr}, games{0} {}
+
+ArchiveReader::~ArchiveReader() {
+    close();
+}
+
+void ArchiveReader::close() {
+    if (data) munmap(const_cast<unsigned char*>(data), size);
+    data = index = nullptr;
+    size = 0;
+    games = 0;
+}
+
+bool ArchiveReader::open(const string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) < 0 || info.st_size < 8 + ARCHIVE_FOOTER_SIZE) {
+        ::close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) return false;
+    data = static_cast<const unsigned char*>(mapped);
+    size = info.st_size;
+
+    const unsigned char* footer = data + size - ARCHIVE_FOOTER_SIZE;
+    uint64_t count = getLittleEndian(footer, 8), indexOffset = getLittleEndian(footer + 8, 8);
+    if (memcmp(data, ARCHIVE_MAGIC, 8) != 0 || memcmp(footer + 16, ARCHIVE_MAGIC, 8) != 0 ||
+        indexOffset > size - ARCHIVE_FOOTER_SIZE || (size - ARCHIVE_FOOTER_SIZE - indexOffset) / 8 != count) {
+        close();
+        return false;
+    }
+    index = data + indexOffset;
+    games = count;
+    return true;
+}
+
+uint64_t ArchiveReader::count() const {
+    return games;
+}
+
+PgnGame ArchiveReader::read(uint64_t i, Board& board) const {
+    if (i >= games) throw runtime_error("No game " + to_string(i) + " in archive");
+    // offsets are checked as integers, before any pointer past the games is formed
+    uint64_t offset = getLittleEndian(index + 8 * i, 8), indexOffset = index - data;
+    if (offset < 8 || offset >= indexOffset) throw runtime_error("Corrupt archive game " + to_string(i));
+    const unsigned char* pos = data + offset;
+    auto need = [&](size_t bytes) {
+        if (bytes > indexOffset - static_cast<uint64_t>(pos - data)) throw runtime_error("Corrupt archive game " + to_string(i));
+    };
+    auto getString = [&]() {
+        need(2);
+        size_t length = getLittleEndian(pos, 2);
+        pos += 2;
+        need(length);
+        string text{reinterpret_cast<const char*>(pos), length};
+        pos += length;
+        return text;
+    };
+
+    PgnGame game;
+    need(2);
+    size_t tags = getLittleEndian(pos, 2);
+    pos += 2;
+    for (size_t t = 0; t < tags; ++t) {
+        string name = getString();
+        game.tags.emplace_back(name, getString());
+    }
+    game.fen = getString();
+    if (game.fen.empty()) game.fen = DEFAULT_FEN;
+    need(5);
+    game.result = results[min<int>(*pos, 3)];
+    size_t plies = getLittleEndian(pos + 1, 4);
+    pos += 5;
+    need(plies);
+
+    if (!Board::isValidFen(game.fen)) throw runtime_error("Corrupt archive game " + to_string(i));
+    board.reset(game.fen);
+    game.moves.reserve(plies);
+    for (size_t ply = 0; ply < plies; ++ply) {
+        vector<EncMove> order = archiveMoveOrder(board);
+        if (pos[ply] >= order.size()) throw runtime_error("Corrupt archive game " + to_string(i));
+        EncMove move = order[pos[ply]];
+        board.makeMove(move);
+        game.moves.push_back(move);
+    }
+    return game;
+}
+
+PgnGame ArchiveReader::read(uint64_t i) const {
+    Board board;
+    return read(i, board);
+}
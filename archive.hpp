@@ -0,0 +1,67 @@
+#ifndef __ARCHIVE_H__
+#define __ARCHIVE_H__
+
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+#include "board.hpp"
+#include "pgn.hpp"
+
+// Binary game archive. A move is stored as its index in the position's
+// legal moves sorted by encoding, which always fits a byte (at most 218
+// legal moves), so a game costs its header plus one byte per ply:
+//
+//   "CHESSGA1"
+//   per game: u16 tag count, then per tag u16 length + name, u16 length + value
+//             u16 length + start FEN (empty for the standard position)
+//             u8 result (0 "*", 1 "1-0", 2 "0-1", 3 "1/2-1/2")
+//             u32 ply count, then one index byte per ply
+//   index:    u64 offset of every game
+//   footer:   u64 game count, u64 index offset, "CHESSGA1"
+//
+// Integers are little-endian. Reading a game replays it, which also checks it.
+class ArchiveWriter {
+    FILE* file;
+    std::vector<uint64_t> offsets;
+    uint64_t written;
+    Board board;
+
+    void put(const void* bytes, size_t length);
+    void putString(const std::string& text);
+    public:
+        ArchiveWriter();
+        ~ArchiveWriter();
+        ArchiveWriter(const ArchiveWriter&) = delete;
+        ArchiveWriter& operator=(const ArchiveWriter&) = delete;
+
+        bool open(const std::string& path);
+        // false, and nothing written, if a move isn't legal in its position
+        bool write(const PgnGame& game);
+        bool close(); // writes the index; false if any write failed
+};
+
+class ArchiveReader {
+    const unsigned char* data;
+    size_t size;
+    const unsigned char* index;
+    uint64_t games;
+
+    void close();
+    public:
+        ArchiveReader();
+        ~ArchiveReader();
+        ArchiveReader(const ArchiveReader&) = delete;
+        ArchiveReader& operator=(const ArchiveReader&) = delete;
+
+        bool open(const std::string& path);
+        uint64_t count() const;
+        // decodes game number i, the board left at its final position
+        PgnGame read(uint64_t i, Board& board) const;
+        PgnGame read(uint64_t i) const;
+};
+
+// the legal moves in archive order
+std::vector<EncMove> archiveMoveOrder(Board& board);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <ostream>
+#include "search.hpp"
+
+struct BenchResult {
+    uint64_t nodes, timeMs;
+};
+
+// Searches the embedded positions to a fixed depth with a cleared search for
+// each one. The node total is a functional signature: it only changes when
+// search behaviour changes, not when the engine merely gets faster.
+BenchResult runBench(int depth, const SearchOptions& options, std::ostream& out);
+
+// Repeats the bench with every pruning technique on, with each one switched
+// off in turn, and with all of them off, reporting nodes and time-to-depth.
+void runPruningBench(int depth, const SearchOptions& options, std::ostream& out);
+
+#endif
@@ -0,0 +1,355 @@
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include "bitbase.hpp"
+
+using namespace std;
+
+#define BITBASE_MAGIC "CHESSBB1"
+
+static BitBoard kingMoves[BOARD_SIZE], knightMoves[BOARD_SIZE], pawnCaptures[BOARD_SIZE];
+
+static void initTables() {
+    static bool initialised = false;
+    if (initialised) return;
+    for (int square = 0; square < BOARD_SIZE; ++square) {
+        kingMoves[square] = maskKingAttacks(square);
+        knightMoves[square] = maskKnightAttacks(square);
+        pawnCaptures[square] = maskPawnAttacks(WHITE_SIDE, square);
+    }
+    initialised = true;
+}
+
+// A position of one ending, the stronger side playing white.
+struct BitbasePosition {
+    int stm; // 0 when the stronger side moves
+    int kings[2];
+    int squares[2];
+};
+
+static uint64_t tableSize(const string& pieces) {
+    return 2ULL << (6 * (2 + pieces.size()));
+}
+
+static uint64_t encode(const BitbasePosition& pos, int count) {
+    uint64_t index = (static_cast<uint64_t>(pos.stm) * 64 + pos.kings[0]) * 64 + pos.kings[1];
+    for (int i = 0; i < count; ++i) index = index * 64 + pos.squares[i];
+    return index;
+}
+
+static BitbasePosition decode(uint64_t index, int count) {
+    BitbasePosition pos;
+    for (int i = count - 1; i >= 0; --i, index >>= 6) pos.squares[i] = index & 63;
+    pos.kings[1] = index & 63;
+    pos.kings[0] = (index >> 6) & 63;
+    pos.stm = index >> 12;
+    return pos;
+}
+
+// one of the 8 board symmetries: bit 0 mirrors files, bit 1 ranks, bit 2 the a1-h8 diagonal
+static int transform(int symmetry, int square) {
+    int row = square / 8, col = square % 8;
+    if (symmetry & 1) col = 7 - col;
+    if (symmetry & 2) row = 7 - row;
+    if (symmetry & 4) swap(row, col);
+    return row * 8 + col;
+}
+
+// Index of the representative of the position's symmetry class: pawnless
+// endings take whichever of the 8 symmetries puts the strong king in the
+// a8-a5-d5 triangle and gives the smallest index, pawn endings only mirror
+// the pawn onto the a-d files. Interchangeable pieces are kept sorted.
+static uint64_t canonicalIndex(const string& pieces, const BitbasePosition& pos) {
+    int count = pieces.size();
+    bool sortPair = count == 2 && pieces[0] == pieces[1];
+    if (pieces.find('P') != string::npos) {
+        BitbasePosition mirrored = pos;
+        if (pos.squares[0] % 8 > 3) {
+            for (int i = 0; i < 2; ++i) mirrored.kings[i] = transform(1, pos.kings[i]);
+            for (int i = 0; i < count; ++i) mirrored.squares[i] = transform(1, pos.squares[i]);
+        }
+        return encode(mirrored, count);
+    }
+
+    uint64_t best = ~0ULL;
+    for (int symmetry = 0; symmetry < 8; ++symmetry) {
+        int king = transform(symmetry, pos.kings[0]);
+        int row = king / 8, col = king % 8;
+        if (row > 3 || col > 3 || col > row) continue;
+        BitbasePosition mapped = pos;
+        mapped.kings[0] = king;
+        mapped.kings[1] = transform(symmetry, pos.kings[1]);
+        for (int i = 0; i < count; ++i) mapped.squares[i] = transform(symmetry, pos.squares[i]);
+        if (sortPair && mapped.squares[0] > mapped.squares[1]) swap(mapped.squares[0], mapped.squares[1]);
+        best = min(best, encode(mapped, count));
+    }
+    return best;
+}
+
+static BitBoard pieceAttacks(char piece, int square, BitBoard empty) {
+    BitBoard bb = 1ULL << square;
+    switch (piece) {
+        case 'Q': return queenAttacksSetwise(bb, empty);
+        case 'R': return rookAttacksSetwise(bb, empty);
+        case 'B': return bishopAttacksSetwise(bb, empty);
+        case 'N': return knightMoves[square];
+        case 'P': return pawnCaptures[square];
+    }
+    return 0;
+}
+
+// squares attacked by the strong side, sliders stopped by occupancy
+static BitBoard strongAttacks(const string& pieces, const BitbasePosition& pos, BitBoard occupancy) {
+    BitBoard attacks = kingMoves[pos.kings[0]];
+    for (size_t i = 0; i < pieces.size(); ++i) attacks |= pieceAttacks(pieces[i], pos.squares[i], ~occupancy);
+    return attacks;
+}
+
+static BitBoard occupancyOf(const BitbasePosition& pos, int count) {
+    BitBoard occupancy = (1ULL << pos.kings[0]) | (1ULL << pos.kings[1]);
+    for (int i = 0; i < count; ++i) occupancy |= 1ULL << pos.squares[i];
+    return occupancy;
+}
+
+static bool isValid(const string& pieces, const BitbasePosition& pos) {
+    int count = pieces.size();
+    BitBoard occupancy = occupancyOf(pos, count);
+    if (countBits(occupancy) != count + 2) return false;
+    if (kingMoves[pos.kings[0]] & (1ULL << pos.kings[1])) return false;
+    for (int i = 0; i < count; ++i) {
+        int row = pos.squares[i] / 8;
+        if (pieces[i] == 'P' && (row == 0 || row == 7)) return false;
+    }
+    // the weak king can't be in check with the strong side to move
+    if (pos.stm == 0 && (strongAttacks(pieces, pos, occupancy) & (1ULL << pos.kings[1]))) return false;
+    return true;
+}
+
+Bitbases::Bitbases() {
+    initTables();
+    // KPK promotes into KQK and KRK, so those come first
+    const char* names[][2] = { {"KQK", "Q"}, {"KRK", "R"}, {"KPK", "P"}, {"KBNK", "BN"}, {"KBBK", "BB"} };
+    for (auto& name : names) endgames.push_back(Endgame{name[0], name[1], {}});
+}
+
+Bitbases::Endgame* Bitbases::find(const string& name) {
+    for (auto& endgame : endgames) {
+        if (endgame.name == name) return &endgame;
+    }
+    return nullptr;
+}
+
+// Retrograde passes alternate between the two halves of the table: a pass
+// over one side to move only reads the other half, so the threads, each
+// owning a range of whole words, never touch a word another one writes.
+void Bitbases::build(Endgame& endgame, int threads) {
+    const string& pieces = endgame.pieces;
+    int count = pieces.size();
+    uint64_t words = tableSize(pieces) / 64, half = words / 2;
+    endgame.wins.assign(words, 0);
+    vector<uint64_t> valid(words, 0);
+    const Endgame* queens = find("KQK");
+    const Endgame* rooks = find("KRK");
+
+    auto isWin = [&](const Endgame& table, const BitbasePosition& pos) {
+        uint64_t index = canonicalIndex(table.pieces, pos);
+        return (table.wins[index / 64] >> (index % 64)) & 1;
+    };
+
+    // strong side to move: some move reaches a won position
+    auto strongWins = [&](BitbasePosition pos) {
+        BitBoard occupancy = occupancyOf(pos, count);
+        BitBoard barred = occupancy | kingMoves[pos.kings[1]];
+        BitbasePosition next = pos;
+        next.stm = 1;
+
+        for (BitBoard targets = kingMoves[pos.kings[0]] & ~barred; targets; targets &= targets - 1) {
+            next.kings[0] = getLSBIndex(targets);
+            if (isWin(endgame, next)) return true;
+        }
+        next.kings[0] = pos.kings[0];
+
+        for (int i = 0; i < count; ++i) {
+            int from = pos.squares[i];
+            BitBoard targets;
+            if (pieces[i] == 'P') {
+                targets = (1ULL << (from - 8)) & ~occupancy;
+                if (targets && from / 8 == 6) targets |= (1ULL << (from - 16)) & ~occupancy;
+                if (targets && from / 8 == 1) {
+                    // promotions: a minor piece against a bare king can't win
+                    BitbasePosition promoted = next;
+                    promoted.squares[0] = from - 8;
+                    if (isWin(*queens, promoted) || isWin(*rooks, promoted)) return true;
+                    continue;
+                }
+            } else {
+                targets = pieceAttacks(pieces[i], from, ~occupancy) & ~occupancy;
+            }
+            for (; targets; targets &= targets - 1) {
+                next.squares[i] = getLSBIndex(targets);
+                if (isWin(endgame, next)) return true;
+            }
+            next.squares[i] = from;
+        }
+        return false;
+    };
+
+    // weak side to move: checkmated, or every move reaches a won position
+    auto weakLoses = [&](BitbasePosition pos) {
+        BitBoard weakKing = 1ULL << pos.kings[1];
+        BitBoard occupancy = occupancyOf(pos, count);
+        BitBoard attacks = strongAttacks(pieces, pos, occupancy & ~weakKing);
+        BitBoard targets = kingMoves[pos.kings[1]] & ~attacks;
+        if (!targets) return (attacks & weakKing) != 0;
+        // taking any piece leaves a lone minor or nothing, both drawn
+        if (targets & occupancy) return false;
+
+        BitbasePosition next = pos;
+        next.stm = 0;
+        for (; targets; targets &= targets - 1) {
+            next.kings[1] = getLSBIndex(targets);
+            if (!isWin(endgame, next)) return false;
+        }
+        return true;
+    };
+
+    auto forRanges = [&](function<void(uint64_t, uint64_t)> work) {
+        vector<thread> workers;
+        uint64_t chunk = (half + threads - 1) / threads;
+        for (int i = 1; i < threads; ++i) {
+            uint64_t begin = min(half, i * chunk), end = min(half, begin + chunk);
+            workers.emplace_back(work, begin, end);
+        }
+        work(0, min(half, chunk));
+        for (auto& t : workers) t.join();
+    };
+
+    forRanges([&](uint64_t begin, uint64_t end) {
+        for (uint64_t stm = 0; stm < 2; ++stm) {
+            for (uint64_t word = stm * half + begin; word < stm * half + end; ++word) {
+                for (int bit = 0; bit < 64; ++bit) {
+                    uint64_t index = word * 64 + bit;
+                    BitbasePosition pos = decode(index, count);
+                    if (isValid(pieces, pos) && canonicalIndex(pieces, pos) == index) valid[word] |= 1ULL << bit;
+                }
+            }
+        }
+    });
+
+    // the weak side moves first so checkmates seed the strong side's pass
+    int stm = 1, idlePasses = 0;
+    while (idlePasses < 2) {
+        atomic<uint64_t> changed{0};
+        forRanges([&](uint64_t begin, uint64_t end) {
+            uint64_t found = 0;
+            for (uint64_t word = stm * half + begin; word < stm * half + end; ++word) {
+                uint64_t wins = endgame.wins[word];
+                for (BitBoard todo = valid[word] & ~wins; todo; todo &= todo - 1) {
+                    int bit = getLSBIndex(todo);
+                    BitbasePosition pos = decode(word * 64 + bit, count);
+                    if (stm == 0 ? strongWins(pos) : weakLoses(pos)) {
+                        wins |= 1ULL << bit;
+                        ++found;
+                    }
+                }
+                endgame.wins[word] = wins;
+            }
+            changed += found;
+        });
+        idlePasses = changed ? 0 : idlePasses + 1;
+        stm ^= 1;
+    }
+}
+
+void Bitbases::generate(const string& dir, int threads, ostream& out) {
+    for (auto& endgame : endgames) {
+        uint64_t startTime = getCurrentTimeInMs();
+        build(endgame, max(1, threads));
+
+        uint64_t wins = 0;
+        for (uint64_t word : endgame.wins) wins += countBits(word);
+        string path = dir + "/" + endgame.name + ".bb";
+        ofstream file{path, ios::binary};
+        uint64_t words = endgame.wins.size();
+        file.write(BITBASE_MAGIC, 8);
+        file.write(reinterpret_cast<const char*>(&words), sizeof(words));
+        file.write(reinterpret_cast<const char*>(endgame.wins.data()), words * sizeof(uint64_t));
+        if (!file) throw runtime_error("Could not write bitbase: " + path);
+
+        out << endgame.name << ": " << wins << " won positions, "
+            << getCurrentTimeInMs() - startTime << " ms, " << path << endl;
+    }
+}
+
+int Bitbases::load(const string& dir) {
+    int loaded = 0;
+    for (auto& endgame : endgames) {
+        endgame.wins.clear();
+        ifstream file{dir + "/" + endgame.name + ".bb", ios::binary};
+        char magic[8];
+        uint64_t words = 0;
+        if (!file.read(magic, 8) || memcmp(magic, BITBASE_MAGIC, 8) != 0) continue;
+        if (!file.read(reinterpret_cast<char*>(&words), sizeof(words))) continue;
+        if (words != tableSize(endgame.pieces) / 64) continue;
+        vector<uint64_t> wins(words);
+        if (!file.read(reinterpret_cast<char*>(wins.data()), words * sizeof(uint64_t))) continue;
+        endgame.wins.swap(wins);
+        ++loaded;
+    }
+    return loaded;
+}
+
+bool Bitbases::isLoaded() const {
+    for (const auto& endgame : endgames) {
+        if (!endgame.wins.empty()) return true;
+    }
+    return false;
+}
+
+// The ending whose pieces the side other than the lone king has, if loaded.
+const Bitbases::Endgame* Bitbases::match(Board& board, int& strongSide) const {
+    if (countBits(board.getOccupancyBySide(BOTH_SIDE)) > 4) return nullptr;
+    if (board.getOccupancyBySide(BLACK_SIDE) == board.getPieceBB('k')) strongSide = WHITE_SIDE;
+    else if (board.getOccupancyBySide(WHITE_SIDE) == board.getPieceBB('K')) strongSide = BLACK_SIDE;
+    else return nullptr;
+
+    string pieces;
+    for (char piece : string{"QRBNP"}) {
+        char type = strongSide == WHITE_SIDE ? piece : tolower(piece);
+        pieces.append(countBits(board.getPieceBB(type)), piece);
+    }
+    for (const auto& endgame : endgames) {
+        if (endgame.pieces == pieces && !endgame.wins.empty()) return &endgame;
+    }
+    return nullptr;
+}
+
+bool Bitbases::probe(Board& board, int& result) const {
+    int strongSide;
+    const Endgame* endgame = match(board, strongSide);
+    if (!endgame) return false;
+
+    // seen from the strong side as white: black's squares are flipped vertically
+    int flip = strongSide == WHITE_SIDE ? 0 : 56;
+    BitbasePosition pos;
+    pos.stm = board.getSide() == strongSide ? 0 : 1;
+    pos.kings[0] = board.getKingSquare(strongSide) ^ flip;
+    pos.kings[1] = board.getKingSquare(strongSide ^ 1) ^ flip;
+    int count = 0;
+    for (char piece : endgame->pieces) {
+        char type = strongSide == WHITE_SIDE ? piece : tolower(piece);
+        BitBoard bb = board.getPieceBB(type);
+        // the second of two like pieces is the next one along
+        if (count > 0 && endgame->pieces[count - 1] == piece) bb &= bb - 1;
+        pos.squares[count++] = getLSBIndex(bb) ^ flip;
+    }
+
+    uint64_t index = canonicalIndex(endgame->pieces, pos);
+    bool win = (endgame->wins[index / 64] >> (index % 64)) & 1;
+    result = !win ? 0 : (pos.stm == 0 ? 1 : -1);
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef __BITBASE_H__
+#define __BITBASE_H__
+
+#include <string>
+#include <vector>
+#include "board.hpp"
+
+// Win/draw bitbases for endings where one side has a lone king. Positions
+// are seen from the stronger side as white, indexed by
+// [side to move][strong king][weak king][piece 1][piece 2], one bit each:
+// set when the stronger side wins. The weak side can never win these, so a
+// clear bit is an exact draw.
+//
+// Built in-process by retrograde iteration: a position with the strong side
+// to move is won if some move reaches a won position, one with the weak side
+// to move if it is mate or every move does. Passes repeat until nothing
+// changes, each one split over threads by ranges of 64-position words.
+class Bitbases {
+    struct Endgame {
+        std::string name;   // e.g. "KBNK"
+        std::string pieces; // the stronger side's pieces besides the king
+        std::vector<uint64_t> wins;
+    };
+    std::vector<Endgame> endgames;
+
+    Endgame* find(const std::string& name);
+    const Endgame* match(Board& board, int& strongSide) const;
+    void build(Endgame& endgame, int threads);
+    public:
+        Bitbases();
+        // generates every supported ending, in dependency order, into dir
+        void generate(const std::string& dir, int threads, std::ostream& out);
+        int load(const std::string& dir); // returns the number of endings loaded
+        bool isLoaded() const;
+        // result for the side to move: 1 win, 0 draw, -1 loss
+        bool probe(Board& board, int& result) const;
+};
+
+#endif
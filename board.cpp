@@ -1,25 +1,56 @@
 #include <iostream>
 #include "board.hpp"
 #include "util.hpp"
+#include "profile.hpp"
+#include "memory.hpp"
 #include <cstring>
+#include <mutex>
+#include <sstream>
 
 using namespace std;
 using namespace bitutil;
 using namespace helpers;
 
-#define DEFAULT_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR"
+BitBoard Board::pawnAttacks[2][BOARD_SIZE];
+BitBoard Board::knightAttacks[BOARD_SIZE];
+BitBoard Board::kingAttacks[BOARD_SIZE];
+BitBoard (*Board::bishopAttacks)[512] = nullptr;
+BitBoard (*Board::rookAttacks)[4096] = nullptr;
+BitBoard Board::bishopMasks[BOARD_SIZE];
+BitBoard Board::rookMasks[BOARD_SIZE];
+static once_flag attackTablesFlag;
 
 void Board::initializeBoard(string fen) {
-    ply = 0;
+    istringstream ss{fen};
+    string placement, side = "w", castling = "-", enpassant = "-";
+    ss >> placement >> side >> castling >> enpassant;
+
+    ply = side == "b" ? 1 : 0;
     fifty = 0;
-    castlingRight = 15;
+    startMove = 1;
+    ss >> fifty >> startMove;
+    if (startMove < 1) startMove = 1; // absent from shortened FENs
+    castlingRight = 0;
+    for (char c : castling) {
+        if (c == 'K') castlingRight |= castlingSideMask[WHITE_SIDE][0];
+        else if (c == 'Q') castlingRight |= castlingSideMask[WHITE_SIDE][1];
+        else if (c == 'k') castlingRight |= castlingSideMask[BLACK_SIDE][0];
+        else if (c == 'q') castlingRight |= castlingSideMask[BLACK_SIDE][1];
+    }
+    startEnpassant = enpassant == "-" ? nsq : getSquareFromStr(enpassant);
+    moveHistory.clear();
+
+    hashKey = castlingKey(castlingRight);
+    if (ply % 2) hashKey ^= sideKey();
+    if (startEnpassant != nsq) hashKey ^= enpassantKey(startEnpassant);
+    pawnKey = 0ULL;
     pieceMaps = {
         {'p', 0ULL}, {'r', 0ULL},{'n', 0ULL}, {'b', 0ULL}, {'q', 0ULL}, {'k', 0ULL}, 
         {'P', 0ULL}, {'R', 0ULL},{'N', 0ULL}, {'B', 0ULL}, {'Q', 0ULL}, {'K', 0ULL}
     };
     playerPieces = {{'P', 'N', 'B', 'R', 'Q', 'K'}, {'p', 'n', 'b', 'r', 'q', 'k'}};
     int row = 0, col = 0;
-    for (char c : fen) {
+    for (char c : placement) {
         if (c == '/') {
             col = 0;
             ++row;
@@ -33,7 +64,7 @@ void Board::initializeBoard(string fen) {
         }
     }
     computeOccupancyMaps();
-    computeAttackBoards();
+    call_once(attackTablesFlag, computeAttackBoards);
 }
 
 void Board::computeOccupancyMaps() {
@@ -46,6 +77,10 @@ void Board::computeOccupancyMaps() {
 }
 
 void Board::computeAttackBoards() {
+    // shared for the life of the process, never freed
+    void* sliders = allocateLarge(BOARD_SIZE * (4096 + 512) * sizeof(BitBoard));
+    rookAttacks = static_cast<BitBoard (*)[4096]>(sliders);
+    bishopAttacks = reinterpret_cast<BitBoard (*)[512]>(rookAttacks + BOARD_SIZE);
     for (int square = 0; square < BOARD_SIZE; ++square) {
         pawnAttacks[WHITE_SIDE][square] = maskPawnAttacks(WHITE_SIDE, square);
         pawnAttacks[BLACK_SIDE][square] = maskPawnAttacks(BLACK_SIDE, square);
@@ -79,15 +114,78 @@ void Board::computeSliderAttacks(BitBoard mask, bool isBishop, int square) {
 
 Board::Board() { initializeBoard(DEFAULT_FEN); }
 
+Board::Board(const string& fen) { initializeBoard(fen); }
+
+void Board::reset(const string& fen) { initializeBoard(fen); }
+
+static bool isCount(const string& field) {
+    return field.empty() || (field.size() < 10 && field.find_first_not_of("0123456789") == string::npos);
+}
+
+// initializeBoard trusts its input; this rejects anything it would misread
+bool Board::isValidFen(const string& fen) {
+    istringstream ss{fen};
+    string placement, side = "w", castling = "-", enpassant = "-", fifty, moves, extra;
+    if (!(ss >> placement)) return false;
+    ss >> side >> castling >> enpassant >> fifty >> moves;
+    if (ss >> extra || !isCount(fifty) || !isCount(moves)) return false;
+
+    char squares[BOARD_SIZE];
+    int row = 0, col = 0, kings[2] = {0, 0};
+    for (char c : placement) {
+        if (c == '/') {
+            if (col != BOARD_WIDTH || ++row == BOARD_WIDTH) return false;
+            col = 0;
+        } else if (c >= '1' && c <= '8') {
+            for (int i = 0; i < c - '0'; ++i) {
+                if (col == BOARD_WIDTH) return false;
+                squares[row * BOARD_WIDTH + col++] = '.';
+            }
+        } else if (string("PNBRQKpnbrqk").find(c) != string::npos) {
+            if (col == BOARD_WIDTH) return false;
+            if ((c == 'P' || c == 'p') && (row == 0 || row == BOARD_WIDTH - 1)) return false;
+            if (c == 'K' || c == 'k') ++kings[c == 'k'];
+            squares[row * BOARD_WIDTH + col++] = c;
+        } else {
+            return false;
+        }
+    }
+    if (row != BOARD_WIDTH - 1 || col != BOARD_WIDTH || kings[0] != 1 || kings[1] != 1) return false;
+
+    if (side != "w" && side != "b") return false;
+    if (castling != "-") {
+        // a right needs its king and rook still at home
+        for (char c : castling) {
+            if (c == 'K' && squares[60] == 'K' && squares[63] == 'R') continue;
+            if (c == 'Q' && squares[60] == 'K' && squares[56] == 'R') continue;
+            if (c == 'k' && squares[4] == 'k' && squares[7] == 'r') continue;
+            if (c == 'q' && squares[4] == 'k' && squares[0] == 'r') continue;
+            return false;
+        }
+    }
+    if (enpassant != "-") {
+        char rank = side == "w" ? '6' : '3';
+        if (enpassant.size() != 2 || enpassant[0] < 'a' || enpassant[0] > 'h' || enpassant[1] != rank) return false;
+    }
+
+    Board board{fen};
+    return !board.isKingInCheck(board.getSide() ^ 1);
+}
+
 void Board::setSquare(char piece, int square) {
     setBit(pieceMaps[piece], square);
+    hashKey ^= pieceKey(piece, square);
+    if (piece == 'P' || piece == 'p') pawnKey ^= pieceKey(piece, square);
 }
 
 void Board::removeSquare(char piece, int square) {
     popBit(pieceMaps[piece], square);
+    hashKey ^= pieceKey(piece, square);
+    if (piece == 'P' || piece == 'p') pawnKey ^= pieceKey(piece, square);
 }
 
 char Board::getSquare(int square) const {
+    PROFILE_SCOPE(PROF_GET_SQUARE);
     for (const auto& bb : pieceMaps) {
         if (getBit(bb.second, square)) {
             return bb.first;
@@ -100,6 +198,49 @@ int Board::getSide() const {
     return ply % 2;
 } 
 
+BitBoard Board::getHashKey() const {
+    return hashKey;
+}
+
+BitBoard Board::getPositionKey() {
+    int enpassant = getEnpassantSquare();
+    if (enpassant == nsq) return hashKey;
+    // strip the en passant key, then add it back only if a capture there is legal
+    BitBoard key = hashKey ^ enpassantKey(enpassant);
+    int side = getSide();
+    BitBoard attackers = pawnAttacks[side ^ 1][enpassant] & pieceMaps[side == WHITE_SIDE ? 'P' : 'p'];
+    while (attackers) {
+        int source = getLSBIndex(attackers);
+        popBit(attackers, source);
+        if (makeMove(Move{source, enpassant, EN_PASSANT}.move) != ILLEGAL_MOVE) {
+            undoMove();
+            return key ^ enpassantKey(enpassant);
+        }
+    }
+    return key;
+}
+
+BitBoard Board::getPawnKey() const {
+    return pawnKey;
+}
+
+int Board::getCastlingRight() const {
+    return castlingRight;
+}
+
+int Board::getFifty() const {
+    return fifty;
+}
+
+// True if the current position already occurred since the last irreversible move.
+bool Board::isRepetition() const {
+    int size = moveHistory.size();
+    for (int i = size - 2; i >= 0 && i >= size - fifty; i -= 2) {
+        if (moveHistory[i].hashKey == hashKey) return true;
+    }
+    return false;
+}
+
 BitBoard Board::getOccupancyBySide(int side) const {
     return occupancyMaps[side];
 }
@@ -123,6 +264,7 @@ bool Board::isKingInCheck(int side) {
 }
 
 bool Board::isSquareAttacked(int side, int square) {
+    PROFILE_SCOPE(PROF_IS_SQUARE_ATTACKED);
     BitBoard pawnBB = (side == WHITE_SIDE ? pieceMaps['p'] : pieceMaps['P']);
     BitBoard knightBB = (side == WHITE_SIDE ? pieceMaps['n'] : pieceMaps['N']);
     BitBoard kingBB = (side == WHITE_SIDE ? pieceMaps['k'] : pieceMaps['K']);
@@ -130,7 +272,7 @@ bool Board::isSquareAttacked(int side, int square) {
     BitBoard rookBB = (side == WHITE_SIDE ? pieceMaps['r'] : pieceMaps['R']);
     BitBoard queenBB = (side == WHITE_SIDE ? pieceMaps['q'] : pieceMaps['Q']);
 
-    if (pawnAttacks[side ^ 1][square] & pawnBB) return true;
+    if (pawnAttacks[side][square] & pawnBB) return true;
     if (knightAttacks[square] & knightBB) return true;
     if (kingAttacks[square] & kingBB) return true;
     if (getBishopAttacks(square, occupancyMaps[BOTH_SIDE]) & bishopBB) return true;
@@ -140,6 +282,35 @@ bool Board::isSquareAttacked(int side, int square) {
     return false;
 }
 
+// Union of the attacks of every piece of one kind, computed set-wise so the
+// sliders don't go through the per-square magic lookups one piece at a time.
+BitBoard Board::getPieceAttackMap(char piece) {
+    BitBoard bitboard = pieceMaps[piece];
+    BitBoard empty = getEmptySquares();
+    switch (tolower(piece)) {
+        case 'p': return pawnAttacksSetwise(isupper(piece) ? WHITE_SIDE : BLACK_SIDE, bitboard);
+        case 'n': return knightAttacksSetwise(bitboard);
+        case 'b': return bishopAttacksSetwise(bitboard, empty);
+        case 'r': return rookAttacksSetwise(bitboard, empty);
+        case 'q': return queenAttacksSetwise(bitboard, empty);
+        case 'k': return bitboard ? kingAttacks[getLSBIndex(bitboard)] : 0ULL;
+    }
+    return 0ULL;
+}
+
+// Every square attacked by side's pieces.
+BitBoard Board::getAttackMap(int side) {
+    const vector<char>& sidePieces = playerPieces[side];
+    BitBoard diagonals = pieceMaps[sidePieces[2]] | pieceMaps[sidePieces[4]];
+    BitBoard orthogonals = pieceMaps[sidePieces[3]] | pieceMaps[sidePieces[4]];
+    BitBoard attacks = sliderAttacksSetwise(diagonals, orthogonals, getEmptySquares());
+
+    attacks |= pawnAttacksSetwise(side, pieceMaps[sidePieces[0]]);
+    attacks |= knightAttacksSetwise(pieceMaps[sidePieces[1]]);
+    attacks |= getPieceAttackMap(sidePieces[5]);
+    return attacks;
+}
+
 BitBoard Board::getBishopAttacks(int square, BitBoard occupancy) {
     occupancy &= bishopMasks[square];
     occupancy *= bishopMagics[square];
@@ -170,6 +341,7 @@ EncMove Board::getLastMove(int side) const{
 }
 
 void Board::generatePawnMoves(int side, vector<EncMove>& moveslist) {
+    PROFILE_SCOPE(PROF_GENERATE_PAWN_MOVES);
     int source, target;
     char piece = side == WHITE_SIDE ? 'P' : 'p';
     BitBoard bitboard = pieceMaps[piece], attacks;
@@ -235,6 +407,7 @@ void Board::generatePawnMoves(int side, vector<EncMove>& moveslist) {
 }
 
 void Board::generateKnightMoves(int side, vector<EncMove>& moveslist) {
+    PROFILE_SCOPE(PROF_GENERATE_KNIGHT_MOVES);
     int source, target;
     char piece = side == WHITE_SIDE ? 'N' : 'n';
     BitBoard bitboard = pieceMaps[piece], attacks;
@@ -262,6 +435,7 @@ void Board::generateKnightMoves(int side, vector<EncMove>& moveslist) {
 }
 
 void Board::generateKingMoves(int side, vector<EncMove>& moveslist) {
+    PROFILE_SCOPE(PROF_GENERATE_KING_MOVES);
     int source, target;
     char piece = side == WHITE_SIDE ? 'K' : 'k';
     BitBoard bitboard = pieceMaps[piece], attacks;
@@ -288,6 +462,7 @@ void Board::generateKingMoves(int side, vector<EncMove>& moveslist) {
 }
 
 void Board::generateBishopMoves(int side, vector<EncMove>& moveslist) {
+    PROFILE_SCOPE(PROF_GENERATE_BISHOP_MOVES);
     int source, target;
     char piece = side == WHITE_SIDE ? 'B' : 'b';
     BitBoard bitboard = pieceMaps[piece], attacks;
@@ -313,6 +488,7 @@ void Board::generateBishopMoves(int side, vector<EncMove>& moveslist) {
 }
 
 void Board::generateRookMoves(int side, vector<EncMove>& moveslist) {
+    PROFILE_SCOPE(PROF_GENERATE_ROOK_MOVES);
     int source, target;
     char piece = side == WHITE_SIDE ? 'R' : 'r';
     BitBoard bitboard = pieceMaps[piece], attacks;
@@ -338,6 +514,7 @@ void Board::generateRookMoves(int side, vector<EncMove>& moveslist) {
 }
 
 void Board::generateQueenMoves(int side, vector<EncMove>& moveslist) {
+    PROFILE_SCOPE(PROF_GENERATE_QUEEN_MOVES);
     int source, target;
     char piece = side == WHITE_SIDE ? 'Q' : 'q';
     BitBoard bitboard = pieceMaps[piece], attacks;
@@ -363,6 +540,7 @@ void Board::generateQueenMoves(int side, vector<EncMove>& moveslist) {
 }
 
 void Board::generateSpecialMoves(int side, vector<EncMove>& moveslist) {
+    PROFILE_SCOPE(PROF_GENERATE_SPECIAL_MOVES);
     Move specialMove;
 
     if (!moveHistory.empty()) {
@@ -386,33 +564,52 @@ void Board::generateSpecialMoves(int side, vector<EncMove>& moveslist) {
                 moveslist.push_back(specialMove.move);
             }
         }
+    } else if (startEnpassant != nsq) {
+        char pawn = side == WHITE_SIDE ? 'P' : 'p';
+        BitBoard attackers = pawnAttacks[side ^ 1][startEnpassant] & pieceMaps[pawn];
+        while (attackers) {
+            int source = getLSBIndex(attackers);
+            specialMove = Move{source, startEnpassant, EN_PASSANT};
+            moveslist.push_back(specialMove.move);
+            popBit(attackers, source);
+        }
     }
     
     int kingSquare = getKingSquare(side);
-    if (castlingRight & castlingSideMask[side][0]) {
-        if (!(getBit(occupancyMaps[BOTH_SIDE], kingSquare + 1) || 
-              getBit(occupancyMaps[BOTH_SIDE], kingSquare + 2))) {
-            if (!(isSquareAttacked(side, kingSquare + 1) ||
-                  isSquareAttacked(side, kingSquare + 2))) {
-                specialMove = Move{kingSquare, kingSquare + 2, K_CASTLE};
-                moveslist.push_back(specialMove.move);
-            }
-        }
+    if (!(castlingRight & (castlingSideMask[side][0] | castlingSideMask[side][1]))) return;
+
+    BitBoard enemyAttacks = getAttackMap(side ^ 1);
+    if (canCastle(side, K_CASTLE, enemyAttacks)) {
+        specialMove = Move{kingSquare, kingSquare + 2, K_CASTLE};
+        moveslist.push_back(specialMove.move);
     }
-    if (castlingRight & castlingSideMask[side][1]) {
-        if (!(getBit(occupancyMaps[BOTH_SIDE], kingSquare - 1) || 
-              getBit(occupancyMaps[BOTH_SIDE], kingSquare - 2) ||
-              getBit(occupancyMaps[BOTH_SIDE], kingSquare - 3))) {
-            if (!(isSquareAttacked(side, kingSquare - 1) ||
-                  isSquareAttacked(side, kingSquare - 2))) {
-                specialMove = Move{kingSquare, kingSquare - 2, Q_CASTLE};
-                moveslist.push_back(specialMove.move);
-            }
-        }
+    if (canCastle(side, Q_CASTLE, enemyAttacks)) {
+        specialMove = Move{kingSquare, kingSquare - 2, Q_CASTLE};
+        moveslist.push_back(specialMove.move);
     }
 }
 
+// Castling rights imply king and rook are on their home squares; the path
+// must be empty and the king may not start on, pass or land on an attacked square.
+bool Board::canCastle(int side, MoveType castle, BitBoard enemyAttacks) const {
+    bool kingSide = castle == K_CASTLE;
+    if (!(castlingRight & castlingSideMask[side][kingSide ? 0 : 1])) return false;
+
+    int kingSquare = side == WHITE_SIDE ? e1 : e8;
+    BitBoard path = kingSide ? (3ULL << (kingSquare + 1)) : (7ULL << (kingSquare - 3));
+    BitBoard kingPath = kingSide ? (7ULL << kingSquare) : (7ULL << (kingSquare - 2));
+    return !(occupancyMaps[BOTH_SIDE] & path) && !(enemyAttacks & kingPath);
+}
+
+int Board::getEnpassantSquare() const {
+    if (moveHistory.empty()) return startEnpassant;
+    Move lastMove{moveHistory.back().move};
+    if (lastMove.getMoveType() != DOUBLE_MOVE) return nsq;
+    return (lastMove.getSource() + lastMove.getTarget()) / 2;
+}
+
 vector<EncMove> Board::generatePseudoMoves(int side) {
+    PROFILE_SCOPE(PROF_GENERATE_PSEUDO_MOVES);
     vector<EncMove> moveslist;
 
     generatePawnMoves(side, moveslist);
@@ -427,6 +624,7 @@ vector<EncMove> Board::generatePseudoMoves(int side) {
 }
 
 vector<EncMove> Board::generateLegalMoves(int side) {
+    PROFILE_SCOPE(PROF_GENERATE_LEGAL_MOVES);
     vector<EncMove> moveslist = generatePseudoMoves(side), legalMoves;
     for (auto move : moveslist) {
         int moveFlag = makeMove(move);
@@ -437,8 +635,230 @@ vector<EncMove> Board::generateLegalMoves(int side) {
     return legalMoves;
 }
 
+bool Board::isPseudoLegal(EncMove encMove) {
+    if (encMove == NO_MOVE) return false;
+    Move move{encMove};
+    int side = getSide();
+    int source = move.getSource(), target = move.getTarget();
+    MoveType moveType = move.getMoveType();
+    if (!getBit(occupancyMaps[side], source) || getBit(occupancyMaps[side], target)) return false;
+
+    // captures need an enemy on the target, everything else an empty square
+    bool enemyOnTarget = getBit(occupancyMaps[side ^ 1], target);
+    bool expectsEnemy = move.isCapture() && moveType != EN_PASSANT;
+    if (enemyOnTarget != expectsEnemy) return false;
+
+    char piece = tolower(getSquare(source));
+    if (piece == 'p') {
+        int forward = side == WHITE_SIDE ? -BOARD_WIDTH : BOARD_WIDTH;
+        bool lastRank = side == WHITE_SIDE ? target <= h8 : target >= a1;
+        if (move.isPromotion() != lastRank) return false;
+        switch (moveType) {
+            case QUIET:
+            case KNIGHT_PROMOTION: case BISHOP_PROMOTION: case ROOK_PROMOTION: case QUEEN_PROMOTION:
+                return target == source + forward;
+            case DOUBLE_MOVE: {
+                bool startRank = side == WHITE_SIDE ? (source >= a2 && source <= h2) : (source >= a7 && source <= h7);
+                return startRank && target == source + 2 * forward &&
+                       !getBit(occupancyMaps[BOTH_SIDE], source + forward);
+            }
+            case CAPTURE:
+            case KNIGHT_PROMOTION_CAPTURE: case BISHOP_PROMOTION_CAPTURE:
+            case ROOK_PROMOTION_CAPTURE: case QUEEN_PROMOTION_CAPTURE:
+                return getBit(pawnAttacks[side][source], target);
+            case EN_PASSANT:
+                return target == getEnpassantSquare() && getBit(pawnAttacks[side][source], target);
+            default:
+                return false;
+        }
+    }
+
+    if (move.isCastle()) {
+        return piece == 'k' && source == (side == WHITE_SIDE ? e1 : e8) &&
+               target == source + (moveType == K_CASTLE ? 2 : -2) &&
+               canCastle(side, moveType, getAttackMap(side ^ 1));
+    }
+    if (moveType != QUIET && moveType != CAPTURE) return false;
+
+    BitBoard attacks = 0ULL, occupancy = occupancyMaps[BOTH_SIDE];
+    switch (piece) {
+        case 'n': attacks = knightAttacks[source]; break;
+        case 'b': attacks = getBishopAttacks(source, occupancy); break;
+        case 'r': attacks = getRookAttacks(source, occupancy); break;
+        case 'q': attacks = getQueenAttacks(source, occupancy); break;
+        case 'k': attacks = kingAttacks[source]; break;
+    }
+    return getBit(attacks, target);
+}
+
+// Pieces of blockerSide standing alone between the king on kingSquare and a
+// slider of sliderSide: pinned pieces when the sides differ, discovered
+// check candidates when they are the same.
+BitBoard Board::getBlockers(int kingSquare, int sliderSide, int blockerSide) {
+    const vector<char>& sliders = playerPieces[sliderSide];
+    BitBoard occupancy = occupancyMaps[BOTH_SIDE], blockers = 0ULL;
+    BitBoard snipers = (getBishopAttacks(kingSquare, 0ULL) & (pieceMaps[sliders[2]] | pieceMaps[sliders[4]])) |
+                       (getRookAttacks(kingSquare, 0ULL) & (pieceMaps[sliders[3]] | pieceMaps[sliders[4]]));
+    while (snipers) {
+        int sniper = getLSBIndex(snipers);
+        BitBoard sniperBB = 1ULL << sniper;
+        BitBoard between = getBit(getBishopAttacks(kingSquare, 0ULL), sniper)
+            ? getBishopAttacks(kingSquare, sniperBB) & getBishopAttacks(sniper, 1ULL << kingSquare)
+            : getRookAttacks(kingSquare, sniperBB) & getRookAttacks(sniper, 1ULL << kingSquare);
+        between &= occupancy;
+        if (between && countBits(between) == 1 && (between & occupancyMaps[blockerSide])) blockers |= between;
+        popBit(snipers, sniper);
+    }
+    return blockers;
+}
+
+CheckInfo Board::getCheckInfo() {
+    int side = getSide();
+    CheckInfo info;
+    info.kingSquare = getKingSquare(side ^ 1);
+    int kingSquare = info.kingSquare;
+    BitBoard occupancy = occupancyMaps[BOTH_SIDE];
+
+    info.checkSquares[0] = pawnAttacks[side ^ 1][kingSquare];
+    info.checkSquares[1] = knightAttacks[kingSquare];
+    info.checkSquares[2] = getBishopAttacks(kingSquare, occupancy);
+    info.checkSquares[3] = getRookAttacks(kingSquare, occupancy);
+    info.checkSquares[4] = info.checkSquares[2] | info.checkSquares[3];
+    info.checkSquares[5] = 0ULL;
+
+    info.discoverers = getBlockers(kingSquare, side, side);
+    return info;
+}
+
+bool Board::givesCheck(EncMove encMove, const CheckInfo& info) {
+    Move move{encMove};
+    int side = getSide();
+    const vector<char>& ours = playerPieces[side];
+    int source = move.getSource(), target = move.getTarget();
+    MoveType moveType = move.getMoveType();
+    int type = getPieceIndex(getSquare(source)) % 6;
+
+    if (moveType < KNIGHT_PROMOTION && moveType != EN_PASSANT && !move.isCastle()) {
+        if (getBit(info.checkSquares[type], target)) return true;
+        if (!getBit(info.discoverers, source)) return false;
+        // moving along the line to the king keeps it shut
+        BitBoard occupancy = (occupancyMaps[BOTH_SIDE] & ~(1ULL << source)) | (1ULL << target);
+        return (getBishopAttacks(info.kingSquare, occupancy) & (pieceMaps[ours[2]] | pieceMaps[ours[4]])) ||
+               (getRookAttacks(info.kingSquare, occupancy) & (pieceMaps[ours[3]] | pieceMaps[ours[4]]));
+    }
+
+    // promotions, en passant and castling change more than two squares:
+    // rebuild the occupancy and look at the king from the new position
+    BitBoard occupancy = occupancyMaps[BOTH_SIDE] & ~(1ULL << source);
+    BitBoard diagonals = pieceMaps[ours[2]] | pieceMaps[ours[4]];
+    BitBoard orthogonals = pieceMaps[ours[3]] | pieceMaps[ours[4]];
+    if (moveType == EN_PASSANT) {
+        occupancy &= ~(1ULL << (target + BOARD_WIDTH * (1 - 2 * side)));
+        occupancy |= 1ULL << target;
+        if (getBit(info.checkSquares[0], target)) return true;
+    } else if (move.isCastle()) {
+        int rookSource = moveType == K_CASTLE ? target + 1 : target - 2;
+        int rookTarget = moveType == K_CASTLE ? target - 1 : target + 1;
+        occupancy = (occupancy & ~(1ULL << rookSource)) | (1ULL << target) | (1ULL << rookTarget);
+        orthogonals = (orthogonals & ~(1ULL << rookSource)) | (1ULL << rookTarget);
+    } else {
+        occupancy |= 1ULL << target;
+        int promoted = (moveType - KNIGHT_PROMOTION) % 4; // N B R Q
+        if (promoted == 0 && getBit(knightAttacks[info.kingSquare], target)) return true;
+        if (promoted == 1 || promoted == 3) diagonals |= 1ULL << target;
+        if (promoted == 2 || promoted == 3) orthogonals |= 1ULL << target;
+    }
+    return (getBishopAttacks(info.kingSquare, occupancy) & diagonals) ||
+           (getRookAttacks(info.kingSquare, occupancy) & orthogonals);
+}
+
+bool Board::givesCheck(EncMove move) {
+    return givesCheck(move, getCheckInfo());
+}
+
+void Board::generateQuietChecks(int side, vector<EncMove>& moveslist) {
+    CheckInfo info = getCheckInfo();
+    const vector<char>& ours = playerPieces[side];
+    BitBoard empty = getEmptySquares(), occupancy = occupancyMaps[BOTH_SIDE];
+
+    // pieces, including the king, that only check by discovery are verified move by move
+    for (int type = 1; type < 6; ++type) {
+        BitBoard pieces = pieceMaps[ours[type]];
+        while (pieces) {
+            int source = getLSBIndex(pieces);
+            BitBoard attacks = 0ULL;
+            switch (type) {
+                case 1: attacks = knightAttacks[source]; break;
+                case 2: attacks = getBishopAttacks(source, occupancy); break;
+                case 3: attacks = getRookAttacks(source, occupancy); break;
+                case 4: attacks = getQueenAttacks(source, occupancy); break;
+                case 5: attacks = kingAttacks[source]; break;
+            }
+            bool discoverer = getBit(info.discoverers, source);
+            attacks &= empty & (discoverer ? ~0ULL : info.checkSquares[type]);
+            while (attacks) {
+                int target = getLSBIndex(attacks);
+                EncMove move = Move{source, target, QUIET}.move;
+                if (!discoverer || givesCheck(move, info)) moveslist.push_back(move);
+                popBit(attacks, target);
+            }
+            popBit(pieces, source);
+        }
+    }
+
+    BitBoard pawns = pieceMaps[ours[0]];
+    int forward = side == WHITE_SIDE ? -BOARD_WIDTH : BOARD_WIDTH;
+    while (pawns) {
+        int source = getLSBIndex(pawns);
+        int target = source + forward;
+        bool promotes = side == WHITE_SIDE ? target <= h8 : target >= a1;
+        if (!promotes && getBit(empty, target)) {
+            EncMove push = Move{source, target, QUIET}.move;
+            if (givesCheck(push, info)) moveslist.push_back(push);
+            bool startRank = side == WHITE_SIDE ? (source >= a2 && source <= h2) : (source >= a7 && source <= h7);
+            if (startRank && getBit(empty, target + forward)) {
+                EncMove doublePush = Move{source, target + forward, DOUBLE_MOVE}.move;
+                if (givesCheck(doublePush, info)) moveslist.push_back(doublePush);
+            }
+        }
+        popBit(pawns, source);
+    }
+}
+
+// Bulk count for perft leaves. Out of check, a move by anything but the king
+// that isn't pinned and isn't en passant can't expose the king, so only the
+// rest go through make/undo.
+int Board::countLegalMoves() {
+    int side = getSide();
+    int kingSquare = getKingSquare(side);
+    bool inCheck = isKingInCheck(side);
+    BitBoard pinned = getBlockers(kingSquare, side ^ 1, side);
+
+    int count = 0;
+    for (EncMove encMove : generatePseudoMoves(side)) {
+        Move move{encMove};
+        int source = move.getSource();
+        if (!inCheck && source != kingSquare && !getBit(pinned, source) && move.getMoveType() != EN_PASSANT) {
+            ++count;
+        } else if (makeMove(encMove) != ILLEGAL_MOVE) {
+            ++count;
+            undoMove();
+        }
+    }
+    return count;
+}
+
+bool Board::isLegal(EncMove move) {
+    if (!isPseudoLegal(move) || makeMove(move) == ILLEGAL_MOVE) return false;
+    undoMove();
+    return true;
+}
+
 int Board::makeMove(EncMove pseudoMove) {
+    PROFILE_SCOPE(PROF_MAKE_MOVE);
     int side = getSide();
+    BitBoard prevHashKey = hashKey, prevPawnKey = pawnKey;
+    int prevFifty = fifty;
     ++ply;
     ++fifty;
 
@@ -498,15 +918,25 @@ int Board::makeMove(EncMove pseudoMove) {
         setSquare(sourcePiece, target);
     }
 
-    moveHistory.push_back({ pseudoMove, sourcePiece, targetPiece, castlingRight });
+    if (!moveHistory.empty() && Move{moveHistory.back().move}.getMoveType() == DOUBLE_MOVE) {
+        hashKey ^= enpassantKey(Move{moveHistory.back().move}.getTarget());
+    } else if (moveHistory.empty() && startEnpassant != nsq) {
+        hashKey ^= enpassantKey(startEnpassant);
+    }
+    if (moveType == DOUBLE_MOVE) hashKey ^= enpassantKey(target);
+    hashKey ^= sideKey();
+
+    moveHistory.push_back({ pseudoMove, sourcePiece, targetPiece, castlingRight, prevFifty, prevHashKey, prevPawnKey });
     
     #ifdef DEBUG
     // cout << "updating castlingRight:" << bitset<4>(castlingRight) << endl;
     // cout << positions[source] << ": " << bitset<4>(castlingRightsTable[source]) << endl;
     // cout << positions[target] << ": " << bitset<4>(castlingRightsTable[target]) << endl;
     #endif
+    hashKey ^= castlingKey(castlingRight);
     castlingRight &= castlingRightsTable[source];
     castlingRight &= castlingRightsTable[target];
+    hashKey ^= castlingKey(castlingRight);
 
     computeOccupancyMaps();
 
@@ -564,7 +994,186 @@ int Board::makeMove(string& sourceStr, string& targetStr, char promote = 'x') {
     return ILLEGAL_MOVE;
 }
 
+// Standard algebraic notation is decoded backwards from the target: only the
+// pieces of the named type that reach it (through the attack tables, or a
+// pawn push) are candidates, and only when the SAN's disambiguation leaves
+// more than one does any of them get made and unmade. A lone candidate is
+// only checked for pseudo-legality; if it would leave the king in check,
+// makeMove still refuses it.
+EncMove Board::parseSan(const string& san) {
+    string text = san;
+    while (!text.empty() && strchr("+#!?", text.back())) text.pop_back();
+    int side = getSide();
+    int kingSquare = getKingSquare(side);
+    if (text == "O-O" || text == "0-0") {
+        EncMove move = Move{kingSquare, kingSquare + 2, K_CASTLE}.move;
+        return isLegal(move) ? move : NO_MOVE;
+    }
+    if (text == "O-O-O" || text == "0-0-0") {
+        EncMove move = Move{kingSquare, kingSquare - 2, Q_CASTLE}.move;
+        return isLegal(move) ? move : NO_MOVE;
+    }
+
+    // promotion suffix: "e8=Q" or "e8Q"
+    int promotion = -1; // N B R Q as 0-3
+    if (text.size() >= 3 && strchr("NBRQ", text.back())) {
+        promotion = strchr("NBRQ", text.back()) - "NBRQ";
+        text.pop_back();
+        if (text.back() == '=') text.pop_back();
+    }
+    if (text.size() < 2) return NO_MOVE;
+    char file = text[text.size() - 2], rank = text[text.size() - 1];
+    if (file < 'a' || file > 'h' || rank < '1' || rank > '8') return NO_MOVE;
+    int target = (file - 'a') + ('8' - rank) * BOARD_WIDTH;
+
+    size_t start = 0;
+    int type = 0; // P N B R Q K
+    if (strchr("NBRQK", text[0])) {
+        type = strchr("PNBRQK", text[0]) - "PNBRQK";
+        start = 1;
+    }
+    BitBoard from = ~0ULL;
+    bool capture = false;
+    for (size_t i = start; i + 2 < text.size(); ++i) {
+        char c = text[i];
+        if (c == 'x') capture = true;
+        else if (c >= 'a' && c <= 'h') from &= 0x0101010101010101ULL << (c - 'a');
+        else if (c >= '1' && c <= '8') from &= 0xFFULL << (('8' - c) * BOARD_WIDTH);
+        else if (c != '-') return NO_MOVE;
+    }
+    if (promotion >= 0 && type != 0) return NO_MOVE;
+
+    char piece = playerPieces[side][type];
+    BitBoard occupancy = occupancyMaps[BOTH_SIDE];
+    bool enemyOnTarget = getBit(occupancyMaps[side ^ 1], target);
+    int forward = side == WHITE_SIDE ? BOARD_WIDTH : -BOARD_WIDTH; // from the target back to the pawn
+    switch (type) {
+        case 0:
+            if (capture) {
+                from &= pawnAttacks[side ^ 1][target];
+            } else if (getBit(occupancy, target) || target + forward < 0 || target + forward >= BOARD_SIZE) {
+                return NO_MOVE;
+            } else if (getBit(pieceMaps[piece], target + forward)) {
+                from &= 1ULL << (target + forward);
+            } else if (!getBit(occupancy, target + forward) && target / BOARD_WIDTH == (side == WHITE_SIDE ? 4 : 3)) {
+                from &= 1ULL << (target + 2 * forward);
+            } else {
+                return NO_MOVE;
+            }
+            break;
+        case 1: from &= knightAttacks[target]; break;
+        case 2: from &= getBishopAttacks(target, occupancy); break;
+        case 3: from &= getRookAttacks(target, occupancy); break;
+        case 4: from &= getQueenAttacks(target, occupancy); break;
+        case 5: from &= kingAttacks[target]; break;
+    }
+    from &= pieceMaps[piece];
+
+    EncMove found = NO_MOVE;
+    bool single = countBits(from) == 1;
+    while (from) {
+        int source = getLSBIndex(from);
+        popBit(from, source);
+        MoveType moveType = enemyOnTarget ? CAPTURE : QUIET;
+        if (type == 0) {
+            if (capture && !enemyOnTarget) moveType = EN_PASSANT;
+            else if (abs(source - target) == 2 * BOARD_WIDTH) moveType = DOUBLE_MOVE;
+            bool lastRank = target / BOARD_WIDTH == (side == WHITE_SIDE ? 0 : 7);
+            if (lastRank != (promotion >= 0)) return NO_MOVE;
+            if (lastRank) moveType = static_cast<MoveType>((enemyOnTarget ? KNIGHT_PROMOTION_CAPTURE : KNIGHT_PROMOTION) + promotion);
+        }
+        EncMove move = Move{source, target, moveType}.move;
+        if (single ? !isPseudoLegal(move) : !isLegal(move)) continue;
+        if (found != NO_MOVE) return NO_MOVE; // ambiguous
+        found = move;
+    }
+    return found;
+}
+
+// Disambiguation looks only at the other pieces of the mover's type that
+// reach the target, the same way parseSan finds them.
+string Board::toSan(EncMove encMove) {
+    Move move{encMove};
+    int source = move.getSource(), target = move.getTarget();
+    MoveType moveType = move.getMoveType();
+    string san;
+    if (moveType == K_CASTLE) {
+        san = "O-O";
+    } else if (moveType == Q_CASTLE) {
+        san = "O-O-O";
+    } else {
+        int side = getSide();
+        char piece = getSquare(source);
+        int type = getPieceIndex(piece) % 6;
+        string targetStr{static_cast<char>('a' + target % BOARD_WIDTH), static_cast<char>('8' - target / BOARD_WIDTH)};
+        if (type == 0) {
+            if (move.isCapture()) san += static_cast<char>('a' + source % BOARD_WIDTH);
+        } else {
+            san += "PNBRQK"[type];
+            BitBoard occupancy = occupancyMaps[BOTH_SIDE];
+            BitBoard rivals = 0ULL;
+            switch (type) {
+                case 1: rivals = knightAttacks[target]; break;
+                case 2: rivals = getBishopAttacks(target, occupancy); break;
+                case 3: rivals = getRookAttacks(target, occupancy); break;
+                case 4: rivals = getQueenAttacks(target, occupancy); break;
+            }
+            rivals &= pieceMaps[piece] & ~(1ULL << source);
+            bool sameFile = false, sameRank = false, ambiguous = false;
+            while (rivals) {
+                int rival = getLSBIndex(rivals);
+                popBit(rivals, rival);
+                MoveType rivalType = getBit(occupancyMaps[side ^ 1], target) ? CAPTURE : QUIET;
+                if (!isLegal(Move{rival, target, rivalType}.move)) continue;
+                ambiguous = true;
+                if (rival % BOARD_WIDTH == source % BOARD_WIDTH) sameFile = true;
+                if (rival / BOARD_WIDTH == source / BOARD_WIDTH) sameRank = true;
+            }
+            if (ambiguous && (!sameFile || sameRank)) san += static_cast<char>('a' + source % BOARD_WIDTH);
+            if (ambiguous && sameFile) san += static_cast<char>('8' - source / BOARD_WIDTH);
+        }
+        if (move.isCapture()) san += 'x';
+        san += targetStr;
+        if (move.isPromotion()) {
+            san += '=';
+            san += "NBRQ"[(moveType - KNIGHT_PROMOTION) % 4];
+        }
+    }
+
+    if (givesCheck(encMove)) {
+        if (makeMove(encMove) == ILLEGAL_MOVE) return san;
+        san += hasLegalMove() ? '+' : '#';
+        undoMove();
+    }
+    return san;
+}
+
+// Passes the turn without moving a piece, for null-move pruning. Only
+// undoNullMove may take it back.
+void Board::makeNullMove() {
+    BitBoard prevHashKey = hashKey;
+    if (!moveHistory.empty() && Move{moveHistory.back().move}.getMoveType() == DOUBLE_MOVE) {
+        hashKey ^= enpassantKey(Move{moveHistory.back().move}.getTarget());
+    } else if (moveHistory.empty() && startEnpassant != nsq) {
+        hashKey ^= enpassantKey(startEnpassant);
+    }
+    hashKey ^= sideKey();
+
+    moveHistory.push_back({ NO_MOVE, '.', '.', castlingRight, fifty, prevHashKey, pawnKey });
+    ++ply;
+    fifty = 0; // repetitions across a null move don't count
+}
+
+void Board::undoNullMove() {
+    MadeMove& madeMove = moveHistory.back();
+    --ply;
+    fifty = madeMove.fifty;
+    hashKey = madeMove.hashKey;
+    moveHistory.pop_back();
+}
+
 void Board::undoMove() {
+    PROFILE_SCOPE(PROF_UNDO_MOVE);
     if (ply == 0 || moveHistory.empty()) {
         throw runtime_error("Make a move first to undo move!");
     } 
@@ -579,6 +1188,7 @@ void Board::undoMove() {
     char sourcePiece = madeMove.sourcePiece;
     char targetPiece = madeMove.targetPiece;
     castlingRight = madeMove.castlingRight;
+    fifty = madeMove.fifty;
     
     removeSquare(sourcePiece, target);
     setSquare(sourcePiece, source);
@@ -611,21 +1221,196 @@ void Board::undoMove() {
         removeSquare(sourcePiece, target);
     }
 
+    hashKey = madeMove.hashKey;
+    pawnKey = madeMove.pawnKey;
     computeOccupancyMaps();
 }
 
-int Board::checkGameState(int side) {
-    if (fifty == 100) return DRAW;
-    vector<EncMove> legalMoves = generateLegalMoves(side);
-    if (legalMoves.empty()) {
-        if (isKingInCheck(side)) return GAME_OVER;
-        else return DRAW;
-    } 
-    
-    if (isKingInCheck(side)) {
-        cout << "Check!" << endl;
+// Replies to a check, generated straight onto the squares that answer it:
+// king moves, then for a single checker the captures of it and the
+// interpositions between it and the king; castling is never generated.
+// Out of check it is generatePseudoMoves. Pinned pieces are left to makeMove.
+void Board::generateEvasions(int side, vector<EncMove>& moveslist) {
+    int kingSquare = getKingSquare(side);
+    const vector<char>& ours = playerPieces[side];
+    const vector<char>& theirs = playerPieces[side ^ 1];
+    BitBoard occupancy = occupancyMaps[BOTH_SIDE];
+    BitBoard checkers = (pawnAttacks[side][kingSquare] & pieceMaps[theirs[0]]) |
+                        (knightAttacks[kingSquare] & pieceMaps[theirs[1]]) |
+                        (getBishopAttacks(kingSquare, occupancy) & (pieceMaps[theirs[2]] | pieceMaps[theirs[4]])) |
+                        (getRookAttacks(kingSquare, occupancy) & (pieceMaps[theirs[3]] | pieceMaps[theirs[4]]));
+    if (!checkers) {
+        vector<EncMove> all = generatePseudoMoves(side);
+        moveslist.insert(moveslist.end(), all.begin(), all.end());
+        return;
     }
-    return LEGAL_MOVE;
+    generateKingMoves(side, moveslist);
+    // only the king can step out of a double check
+    if (countBits(checkers) > 1) return;
+
+    int checker = getLSBIndex(checkers);
+    BitBoard targets = checkers;
+    if (getBit(getBishopAttacks(kingSquare, 0ULL), checker)) {
+        targets |= getBishopAttacks(kingSquare, checkers) & getBishopAttacks(checker, 1ULL << kingSquare);
+    } else if (getBit(getRookAttacks(kingSquare, 0ULL), checker)) {
+        targets |= getRookAttacks(kingSquare, checkers) & getRookAttacks(checker, 1ULL << kingSquare);
+    }
+    BitBoard enemies = occupancyMaps[side ^ 1];
+
+    for (int kind = 1; kind <= 4; ++kind) {
+        BitBoard pieces = pieceMaps[ours[kind]];
+        while (pieces) {
+            int source = getLSBIndex(pieces);
+            popBit(pieces, source);
+            BitBoard attacks = kind == 1 ? knightAttacks[source]
+                             : kind == 2 ? getBishopAttacks(source, occupancy)
+                             : kind == 3 ? getRookAttacks(source, occupancy)
+                             : getQueenAttacks(source, occupancy);
+            attacks &= targets;
+            while (attacks) {
+                int target = getLSBIndex(attacks);
+                popBit(attacks, target);
+                moveslist.push_back(Move{source, target, getBit(enemies, target) ? CAPTURE : QUIET}.move);
+            }
+        }
+    }
+
+    int forward = side == WHITE_SIDE ? -BOARD_WIDTH : BOARD_WIDTH;
+    int enpassant = getEnpassantSquare();
+    auto addPawnMove = [&](int source, int target, bool capture, bool promotes) {
+        if (!promotes) {
+            moveslist.push_back(Move{source, target, capture ? CAPTURE : QUIET}.move);
+            return;
+        }
+        moveslist.push_back(Move{source, target, capture ? QUEEN_PROMOTION_CAPTURE : QUEEN_PROMOTION}.move);
+        moveslist.push_back(Move{source, target, capture ? ROOK_PROMOTION_CAPTURE : ROOK_PROMOTION}.move);
+        moveslist.push_back(Move{source, target, capture ? KNIGHT_PROMOTION_CAPTURE : KNIGHT_PROMOTION}.move);
+        moveslist.push_back(Move{source, target, capture ? BISHOP_PROMOTION_CAPTURE : BISHOP_PROMOTION}.move);
+    };
+    BitBoard pawns = pieceMaps[ours[0]];
+    while (pawns) {
+        int source = getLSBIndex(pawns);
+        popBit(pawns, source);
+        bool promotes = side == WHITE_SIDE ? source >= a7 && source <= h7 : source >= a2 && source <= h2;
+        bool startRank = side == WHITE_SIDE ? source >= a2 && source <= h2 : source >= a7 && source <= h7;
+        int target = source + forward;
+        if (!getBit(occupancy, target)) {
+            if (getBit(targets, target)) addPawnMove(source, target, false, promotes);
+            int nextTarget = target + forward;
+            if (startRank && !getBit(occupancy, nextTarget) && getBit(targets, nextTarget)) {
+                moveslist.push_back(Move{source, nextTarget, DOUBLE_MOVE}.move);
+            }
+        }
+        BitBoard attacks = pawnAttacks[side][source] & enemies & targets;
+        while (attacks) {
+            int capture = getLSBIndex(attacks);
+            popBit(attacks, capture);
+            addPawnMove(source, capture, true, promotes);
+        }
+        // en passant takes the pawn behind its target square, which may be the checker
+        if (enpassant != nsq && getBit(pawnAttacks[side][source], enpassant) &&
+            (enpassant - forward == checker || getBit(targets, enpassant))) {
+            moveslist.push_back(Move{source, enpassant, EN_PASSANT}.move);
+        }
+    }
+}
+
+// Stops at the first legal move, trying the king first since it is the
+// piece most likely to have one when the position is close to mate.
+bool Board::hasLegalMove() {
+    typedef void (Board::*Generator)(int, vector<EncMove>&);
+    const Generator generators[] = {
+        &Board::generateKingMoves, &Board::generatePawnMoves, &Board::generateKnightMoves,
+        &Board::generateBishopMoves, &Board::generateRookMoves, &Board::generateQueenMoves,
+        &Board::generateSpecialMoves
+    };
+    int side = getSide();
+    vector<EncMove> moveslist;
+    for (Generator generate : generators) {
+        moveslist.clear();
+        (this->*generate)(side, moveslist);
+        for (EncMove move : moveslist) {
+            if (makeMove(move) == ILLEGAL_MOVE) continue;
+            undoMove();
+            return true;
+        }
+    }
+    return false;
+}
+
+// Neither side can mate: bare kings, a single minor piece, or only bishops
+// that all stand on squares of one colour.
+bool Board::isInsufficientMaterial() {
+    if (pieceMaps['P'] | pieceMaps['p'] | pieceMaps['R'] | pieceMaps['r'] | pieceMaps['Q'] | pieceMaps['q']) {
+        return false;
+    }
+    BitBoard knights = pieceMaps['N'] | pieceMaps['n'];
+    BitBoard bishops = pieceMaps['B'] | pieceMaps['b'];
+    if (countBits(knights | bishops) <= 1) return true;
+
+    const BitBoard lightSquares = 0xAA55AA55AA55AA55ULL;
+    return !knights && (!(bishops & lightSquares) || !(bishops & ~lightSquares));
+}
+
+// Earlier occurrences of the current position since the last irreversible move.
+int Board::getRepetitionCount() const {
+    int size = moveHistory.size(), count = 0;
+    for (int i = size - 2; i >= 0 && i >= size - fifty; i -= 2) {
+        if (moveHistory[i].hashKey == hashKey) ++count;
+    }
+    return count;
+}
+
+GameStatus Board::getGameStatus() {
+    int side = getSide();
+    GameStatus status = {ONGOING, isKingInCheck(side)};
+    if (!hasLegalMove()) {
+        status.termination = status.inCheck ? CHECKMATE : STALEMATE;
+    } else if (fifty >= 100) {
+        status.termination = FIFTY_MOVE_RULE;
+    } else if (getRepetitionCount() >= 2) {
+        status.termination = THREEFOLD_REPETITION;
+    } else if (isInsufficientMaterial()) {
+        status.termination = INSUFFICIENT_MATERIAL;
+    }
+    return status;
+}
+
+string Board::getFen() {
+    string fen;
+    for (int row = 0; row < 8; ++row) {
+        int empty = 0;
+        for (int col = 0; col < 8; ++col) {
+            char piece = getSquare(row * BOARD_WIDTH + col);
+            if (piece == '.') {
+                ++empty;
+                continue;
+            }
+            if (empty) fen += static_cast<char>('0' + empty);
+            empty = 0;
+            fen += piece;
+        }
+        if (empty) fen += static_cast<char>('0' + empty);
+        if (row < 7) fen += '/';
+    }
+    fen += getSide() == WHITE_SIDE ? " w " : " b ";
+
+    string castling;
+    if (castlingRight & castlingSideMask[WHITE_SIDE][0]) castling += 'K';
+    if (castlingRight & castlingSideMask[WHITE_SIDE][1]) castling += 'Q';
+    if (castlingRight & castlingSideMask[BLACK_SIDE][0]) castling += 'k';
+    if (castlingRight & castlingSideMask[BLACK_SIDE][1]) castling += 'q';
+    fen += castling.empty() ? "-" : castling;
+
+    int enpassant = getEnpassantSquare();
+    fen += ' ';
+    if (enpassant == nsq) {
+        fen += '-';
+    } else {
+        fen += static_cast<char>('a' + enpassant % BOARD_WIDTH);
+        fen += static_cast<char>('8' - enpassant / BOARD_WIDTH);
+    }
+    return fen + " " + to_string(fifty) + " " + to_string(startMove + ply / 2);
 }
 
 void Board::render() {
@@ -6,33 +6,67 @@
 #include <unordered_map>
 #include "move.hpp"
 
+#define DEFAULT_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+// Per-position data for check detection from the side to move's view:
+// squares each piece type (P N B R Q K) would check the enemy king from, and
+// our pieces whose departure may open a slider line onto that king.
+struct CheckInfo {
+    int kingSquare;
+    BitBoard checkSquares[6];
+    BitBoard discoverers;
+};
+
+enum Termination {
+    ONGOING,
+    CHECKMATE,
+    STALEMATE,
+    FIFTY_MOVE_RULE,
+    THREEFOLD_REPETITION,
+    INSUFFICIENT_MATERIAL
+};
+
+// Outcome of the position for the side to move; callers decide what to print.
+struct GameStatus {
+    Termination termination;
+    bool inCheck;
+    bool isOver() const { return termination != ONGOING; }
+    bool isDraw() const { return termination != ONGOING && termination != CHECKMATE; }
+};
+
 class Board {
     struct MadeMove {
         EncMove move;
         char sourcePiece, targetPiece;
-        int castlingRight;
+        int castlingRight, fifty;
+        BitBoard hashKey, pawnKey;
     };
     private:
         int ply, fifty, castlingRight;
+        int startEnpassant; // en passant target from the FEN, before any move is made
+        int startMove; // full move number from the FEN
+        BitBoard hashKey, pawnKey;
         std::unordered_map<char, BitBoard> pieceMaps; 
         BitBoard occupancyMaps[3]; 
         std::vector<std::vector<char>> playerPieces;
         std::vector<MadeMove> moveHistory;
 
-        BitBoard pawnAttacks[2][BOARD_SIZE];   
-        BitBoard knightAttacks[BOARD_SIZE];    
-        BitBoard kingAttacks[BOARD_SIZE];      
-        
-        BitBoard bishopAttacks[BOARD_SIZE][512];    
-        BitBoard rookAttacks[BOARD_SIZE][4096];      
-        
-        BitBoard bishopMasks[BOARD_SIZE]; 
-        BitBoard rookMasks[BOARD_SIZE]; 
+        // attack tables are shared by every board and filled once, on first construction
+        static BitBoard pawnAttacks[2][BOARD_SIZE];
+        static BitBoard knightAttacks[BOARD_SIZE];
+        static BitBoard kingAttacks[BOARD_SIZE];
+
+        // 2.25 MB together, so they share one huge page allocation
+        static BitBoard (*bishopAttacks)[512];
+        static BitBoard (*rookAttacks)[4096];
+
+        static BitBoard bishopMasks[BOARD_SIZE];
+        static BitBoard rookMasks[BOARD_SIZE];
 
         void initializeBoard(std::string fen);
         void computeOccupancyMaps();
-        void computeAttackBoards();
-        void computeSliderAttacks(BitBoard mask, bool isBishop, int square);
+        static void computeAttackBoards();
+        static void computeSliderAttacks(BitBoard mask, bool isBishop, int square);
 
         void generatePawnMoves(int side, std::vector<EncMove>& moveslist);
         void generateKnightMoves(int side, std::vector<EncMove>& moveslist);
@@ -41,34 +75,78 @@ class Board {
         void generateQueenMoves(int side, std::vector<EncMove>& moveslist);
         void generateKingMoves(int side, std::vector<EncMove>& moveslist);
         void generateSpecialMoves(int side, std::vector<EncMove>& moveslist);
+        bool canCastle(int side, MoveType castle, BitBoard enemyAttacks) const;
+        BitBoard getBlockers(int kingSquare, int sliderSide, int blockerSide);
 
         BitBoard getBishopAttacks(int square, BitBoard occupancy);
         BitBoard getRookAttacks(int square, BitBoard occupancy);
         BitBoard getQueenAttacks(int square, BitBoard occupancy);
     public:
         Board();
+        Board(const std::string& fen);
+        void reset(const std::string& fen); // reuse the board for a new game
+        // checks a FEN from outside before it reaches the constructor or reset():
+        // 8 ranks of 8 squares, known pieces, one king a side, consistent
+        // castling and en passant fields, and the side not to move not in check
+        static bool isValidFen(const std::string& fen);
 
         void setSquare(char piece, int square); 
         void removeSquare(char piece, int square); 
         char getSquare(int square) const; 
         
         int getSide() const;
+        BitBoard getHashKey() const;
+        // the hash key with en passant counted only when a capture there is
+        // legal, as Polyglot does, so move orders reaching a position agree
+        BitBoard getPositionKey();
+        BitBoard getPawnKey() const;
+        int getFifty() const;
+        int getCastlingRight() const;
+        int getEnpassantSquare() const; // nsq when the last move wasn't a double push
+        bool isRepetition() const;
         BitBoard getOccupancyBySide(int side) const;
         BitBoard getEmptySquares() const;
         BitBoard getPieceBB(char piece);
         int getKingSquare(int side);
         bool isKingInCheck(int side);
         bool isSquareAttacked(int side, int square); 
+        BitBoard getPieceAttackMap(char piece);
+        BitBoard getAttackMap(int side);
         EncMove getLastMove(int side) const; 
         
         std::vector<EncMove> generatePseudoMoves(int side);
         std::vector<EncMove> generateLegalMoves(int side);
+        int countLegalMoves(); // for the side to move, without keeping the list
+        // Validate a move from outside the generator (TT, killers, books) for
+        // the side to move without building the move list.
+        bool isPseudoLegal(EncMove move);
+        bool isLegal(EncMove move);
+
+        CheckInfo getCheckInfo();
+        bool givesCheck(EncMove move, const CheckInfo& info);
+        bool givesCheck(EncMove move);
+        // quiet moves (no captures, promotions or castling) that give check, for quiescence
+        void generateQuietChecks(int side, std::vector<EncMove>& moveslist);
+        // pseudo-legal replies when side is in check: king steps and, against a
+        // single checker, its capture or an interposition; every move otherwise
+        void generateEvasions(int side, std::vector<EncMove>& moveslist);
         
         int makeMove(EncMove move);
         int makeMove(std::string& source, std::string& target, char promote); 
+        // SAN ("Nbxd7", "e8=Q+", "O-O") for the side to move; NO_MOVE if it
+        // names no move or is ambiguous. A lone candidate is only checked to be
+        // pseudo-legal, so callers must still see makeMove() not return ILLEGAL_MOVE
+        EncMove parseSan(const std::string& san);
+        std::string toSan(EncMove move); // for a legal move of the side to move
+        std::string getFen();
         void undoMove();
+        void makeNullMove();
+        void undoNullMove();
 
-        int checkGameState(int side);
+        bool hasLegalMove();
+        bool isInsufficientMaterial();
+        int getRepetitionCount() const;
+        GameStatus getGameStatus();
         
         void render();
 };
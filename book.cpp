@@ -0,0 +1,196 @@
+#include <cctype>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "book.hpp"
+
+using namespace std;
+
+#define BOOK_ENTRY_SIZE 16
+
+// Polyglot piece kinds alternate black/white: p P n N b B r R q Q k K
+const static char polyglotPieces[] = "pPnNbBrRqQkK";
+
+static uint64_t readBigEndian(const unsigned char* bytes, int count) {
+    uint64_t value = 0;
+    for (int i = 0; i < count; ++i) value = value << 8 | bytes[i];
+    return value;
+}
+
+OpeningBook::OpeningBook(): data{nullptr}, size{0}, path{}, rng{random_device{}()} {
+    // fallback: the engine's Zobrist keys laid out the Polyglot way
+    for (int kind = 0; kind < 12; ++kind) {
+        for (int row = 0; row < 8; ++row) {
+            for (int file = 0; file < 8; ++file) {
+                randoms[64 * kind + 8 * row + file] = pieceKey(polyglotPieces[kind], (7 - row) * 8 + file);
+            }
+        }
+    }
+    for (int i = 0; i < 4; ++i) randoms[768 + i] = castlingKey(1 << i);
+    for (int file = 0; file < 8; ++file) randoms[772 + file] = enpassantKey(file);
+    randoms[780] = sideKey();
+}
+
+OpeningBook::~OpeningBook() {
+    close();
+}
+
+void OpeningBook::close() {
+    if (data) munmap(const_cast<unsigned char*>(data), size);
+    data = nullptr;
+    size = 0;
+    path.clear();
+}
+
+bool OpeningBook::open(const string& bookPath) {
+    close();
+    int fd = ::open(bookPath.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) < 0 || info.st_size < BOOK_ENTRY_SIZE) {
+        ::close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) return false;
+
+    data = static_cast<const unsigned char*>(mapped);
+    size = info.st_size - info.st_size % BOOK_ENTRY_SIZE;
+    path = bookPath;
+    return true;
+}
+
+bool OpeningBook::isOpen() const {
+    return data != nullptr;
+}
+
+const string& OpeningBook::getPath() const {
+    return path;
+}
+
+bool OpeningBook::loadRandoms(const string& randomsPath) {
+    ifstream in{randomsPath};
+    string token;
+    BitBoard loaded[POLYGLOT_RANDOMS];
+    int count = 0;
+    while (count < POLYGLOT_RANDOMS && in >> token) {
+        // tolerate C syntax such as "0x9D39247E33776D41ULL,"
+        size_t start = token.find("0x") == 0 || token.find("0X") == 0 ? 2 : 0;
+        size_t end = start;
+        while (end < token.size() && isxdigit(static_cast<unsigned char>(token[end]))) ++end;
+        if (end == start) continue;
+        loaded[count++] = stoull(token.substr(start, end - start), nullptr, 16);
+    }
+    if (count < POLYGLOT_RANDOMS) return false;
+    copy(loaded, loaded + POLYGLOT_RANDOMS, randoms);
+    return true;
+}
+
+BitBoard OpeningBook::polyglotKey(Board& board) const {
+    BitBoard key = 0ULL;
+    for (int square = 0; square < BOARD_SIZE; ++square) {
+        char piece = board.getSquare(square);
+        if (piece == '.') continue;
+        int kind = 2 * (getPieceIndex(piece) % 6) + (isupper(piece) ? 1 : 0);
+        key ^= randoms[64 * kind + 8 * (7 - square / 8) + square % 8];
+    }
+
+    // castling rights use the same K Q k q bit order as the board
+    int castling = board.getCastlingRight();
+    for (int i = 0; i < 4; ++i) {
+        if (castling & (1 << i)) key ^= randoms[768 + i];
+    }
+
+    // en passant only counts when a pawn of the side to move can take
+    int side = board.getSide(), enpassant = board.getEnpassantSquare();
+    if (enpassant != nsq) {
+        int pawnSquare = enpassant + BOARD_WIDTH * (side == WHITE_SIDE ? 1 : -1);
+        char pawn = side == WHITE_SIDE ? 'P' : 'p';
+        int file = enpassant % BOARD_WIDTH;
+        if ((file > 0 && board.getSquare(pawnSquare - 1) == pawn) ||
+            (file < 7 && board.getSquare(pawnSquare + 1) == pawn)) {
+            key ^= randoms[772 + file];
+        }
+    }
+
+    if (side == WHITE_SIDE) key ^= randoms[780];
+    return key;
+}
+
+// Polyglot moves: to file/row in bits 0-5, from file/row in bits 6-11,
+// promotion piece (n b r q = 1..4) in bits 12-14; castling is king takes rook.
+EncMove OpeningBook::toEncMove(Board& board, int polyglotMove) const {
+    int target = (7 - ((polyglotMove >> 3) & 7)) * 8 + (polyglotMove & 7);
+    int source = (7 - ((polyglotMove >> 9) & 7)) * 8 + ((polyglotMove >> 6) & 7);
+    int promotion = (polyglotMove >> 12) & 7;
+
+    for (EncMove encMove : board.generateLegalMoves(board.getSide())) {
+        Move move{encMove};
+        if (move.getSource() != source) continue;
+        int moveTarget = move.getTarget();
+        if (move.getMoveType() == K_CASTLE) moveTarget += 1;
+        else if (move.getMoveType() == Q_CASTLE) moveTarget -= 2;
+        if (moveTarget != target) continue;
+        int movePromotion = move.isPromotion() ? (move.getMoveType() - KNIGHT_PROMOTION) % 4 + 1 : 0;
+        if (movePromotion == promotion) return encMove;
+    }
+    return NO_MOVE;
+}
+
+size_t OpeningBook::findKey(BitBoard key) const {
+    size_t low = 0, high = size / BOOK_ENTRY_SIZE;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (readBigEndian(data + mid * BOOK_ENTRY_SIZE, 8) < key) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+bool OpeningBook::needsStandardKeys() const {
+    if (!data) return false;
+    auto holds = [this](BitBoard key) {
+        size_t i = findKey(key);
+        return i < size / BOOK_ENTRY_SIZE && readBigEndian(data + i * BOOK_ENTRY_SIZE, 8) == key;
+    };
+    Board start;
+    return !holds(polyglotKey(start)) && holds(POLYGLOT_START_KEY);
+}
+
+vector<BookEntry> OpeningBook::lookup(Board& board) const {
+    vector<BookEntry> entries;
+    if (!data) return entries;
+
+    BitBoard key = polyglotKey(board);
+    for (size_t i = findKey(key); i < size / BOOK_ENTRY_SIZE; ++i) {
+        const unsigned char* entry = data + i * BOOK_ENTRY_SIZE;
+        if (readBigEndian(entry, 8) != key) break;
+        EncMove move = toEncMove(board, static_cast<int>(readBigEndian(entry + 8, 2)));
+        if (move != NO_MOVE) entries.push_back({move, static_cast<int>(readBigEndian(entry + 10, 2))});
+    }
+    return entries;
+}
+
+EncMove OpeningBook::probe(Board& board, bool weighted) {
+    vector<BookEntry> entries = lookup(board);
+    if (entries.empty()) return NO_MOVE;
+
+    long total = 0;
+    size_t best = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        total += entries[i].weight;
+        if (entries[i].weight > entries[best].weight) best = i;
+    }
+    if (!weighted || total == 0) return entries[best].move;
+
+    long pick = uniform_int_distribution<long>{0, total - 1}(rng);
+    for (const BookEntry& entry : entries) {
+        pick -= entry.weight;
+        if (pick < 0) return entry.move;
+    }
+    return entries[best].move;
+}
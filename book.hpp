@@ -0,0 +1,56 @@
+#ifndef __BOOK_H__
+#define __BOOK_H__
+
+#include <random>
+#include <string>
+#include <vector>
+#include "board.hpp"
+
+#define POLYGLOT_RANDOMS 781
+#define POLYGLOT_START_KEY 0x463B96181691FC9CULL // the start position under the standard Random64
+
+struct BookEntry {
+    EncMove move;
+    int weight;
+};
+
+// Polyglot .bin opening book. The file is memory-mapped and its 16-byte
+// big-endian entries (key, move, weight, learn), sorted by key, are binary
+// searched in place, so opening a book costs no parsing at all.
+//
+// Polyglot keys come from the 781 Random64 constants of the format. They
+// can be loaded from a text file (any 781 hex numbers, e.g. the array from
+// the reference source) with loadRandoms; until then the engine's own
+// Zobrist keys fill the same layout, which only matches books keyed with them.
+// A standard book read with other keys is told apart by its start position.
+class OpeningBook {
+    const unsigned char* data;
+    size_t size;
+    std::string path;
+    BitBoard randoms[POLYGLOT_RANDOMS];
+    std::mt19937_64 rng;
+
+    void close();
+    size_t findKey(BitBoard key) const; // first entry not below the key
+    EncMove toEncMove(Board& board, int polyglotMove) const;
+    public:
+        OpeningBook();
+        ~OpeningBook();
+        OpeningBook(const OpeningBook&) = delete;
+        OpeningBook& operator=(const OpeningBook&) = delete;
+
+        bool open(const std::string& path);
+        bool isOpen() const;
+        const std::string& getPath() const;
+        bool loadRandoms(const std::string& path);
+        BitBoard polyglotKey(Board& board) const;
+        // the book holds the start position only under the standard key,
+        // so it can't be read until those randoms are loaded
+        bool needsStandardKeys() const;
+        // every legal book move of the position, with its weight
+        std::vector<BookEntry> lookup(Board& board) const;
+        // weighted random choice, or the heaviest move; NO_MOVE when out of book
+        EncMove probe(Board& board, bool weighted);
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include <iostream>
+
+#include "computer.hpp"
+
+using namespace std;
+
+Computer::Computer(int side, const SearchOptions& options, const SearchLimits& limits):
+    Player{side}, search{options}, limits{limits}, book{}, bookWeighted{options.bookWeighted},
+    clock{limits.time}, movesToGo{limits.movesToGo}, ponderThread{}, ponderBoard{}, ponderReport{} {
+    configureBook(options);
+}
+
+Computer::~Computer() {
+    stopPondering();
+}
+
+void Computer::configureBook(const SearchOptions& options) {
+    bookWeighted = options.bookWeighted;
+    if (!options.bookRandoms.empty() && !book.loadRandoms(options.bookRandoms)) {
+        throw runtime_error("Could not read 781 Polyglot randoms from " + options.bookRandoms);
+    }
+    if (options.bookFile.empty()) return;
+    if (options.bookFile != book.getPath() && !book.open(options.bookFile)) {
+        throw runtime_error("Could not open book " + options.bookFile);
+    }
+    if (book.needsStandardKeys()) {
+        throw runtime_error("Book " + options.bookFile + " uses the standard Polyglot keys, set bookrandoms to them");
+    }
+}
+
+void Computer::configure(const SearchOptions& options, const SearchLimits& newLimits) {
+    stopPondering();
+    search.setOptions(options);
+    configureBook(options);
+    if (newLimits.time != limits.time || newLimits.movesToGo != limits.movesToGo) {
+        clock = newLimits.time;
+        movesToGo = newLimits.movesToGo;
+    }
+    limits = newLimits;
+}
+
+bool Computer::saveHash(const string& path) {
+    stopPondering();
+    return search.saveHash(path);
+}
+
+// Plays the predicted reply on a copy of the board and searches it with the
+// clock held until move() learns whether the prediction was right.
+void Computer::startPondering(const Board& board, const vector<EncMove>& pv) {
+    if (!search.getOptions().ponder || pv.size() < 2) return;
+    ponderBoard = board;
+    if (ponderBoard.makeMove(pv[1]) == ILLEGAL_MOVE) return;
+
+    SearchLimits ponderLimits = limits;
+    ponderLimits.time = clock;
+    ponderLimits.movesToGo = movesToGo;
+    // prepared here, so a stop() or ponderhit() racing the thread's start is kept
+    search.prepare(ponderBoard, ponderLimits, true);
+    ponderThread = thread([this]() {
+        ponderReport = search.run();
+    });
+}
+
+void Computer::stopPondering() {
+    if (!ponderThread.joinable()) return;
+    search.stop();
+    ponderThread.join();
+}
+
+// "move" takes optional per-move limits, e.g. "move depth 6", "move movetime 500"
+// or a clock as "move wtime 60000 btime 58000 winc 1000 binc 1000 movestogo 20"
+int Computer::move(Board* chessBoard, istringstream &ss) {
+    uint64_t startTime = getCurrentTimeInMs();
+    SearchLimits moveLimits = limits;
+    moveLimits.time = clock;
+    moveLimits.movesToGo = movesToGo;
+    bool white = side == WHITE_SIDE;
+    string name;
+    uint64_t value;
+    while (ss >> name >> value) {
+        if (name == "depth") moveLimits.depth = static_cast<int>(value);
+        else if (name == "movetime") moveLimits.movetime = value;
+        else if (name == "nodes") moveLimits.nodes = value;
+        else if (name == (white ? "wtime" : "btime")) clock = moveLimits.time = value;
+        else if (name == (white ? "winc" : "binc")) moveLimits.increment = value;
+        else if (name == "movestogo") movesToGo = moveLimits.movesToGo = static_cast<int>(value);
+    }
+
+    // a book move is played without searching or touching the clock
+    EncMove bookMove = book.isOpen() ? book.probe(*chessBoard, bookWeighted) : NO_MOVE;
+    if (bookMove != NO_MOVE) {
+        stopPondering();
+        cout << "bestmove " << Move{bookMove}.toString() << " (book)" << endl;
+        return chessBoard->makeMove(bookMove);
+    }
+
+    // the ponder search runs under the configured depth and node limits, so
+    // a move given others is searched afresh even after the expected reply
+    bool ponderhit = ponderThread.joinable() && ponderBoard.getHashKey() == chessBoard->getHashKey() &&
+                     moveLimits.depth == limits.depth && moveLimits.nodes == limits.nodes;
+    SearchReport report;
+    if (ponderhit) {
+        // ponderhit: the warm search carries on under the real clock
+        search.ponderhit(moveLimits);
+        ponderThread.join();
+        report = ponderReport;
+    } else {
+        // a miss throws the ponder search away, but its TT entries stay
+        stopPondering();
+        report = search.run(*chessBoard, moveLimits);
+    }
+    if (report.bestMove == NO_MOVE) throw runtime_error("No legal move to play!");
+
+    if (clock) {
+        uint64_t elapsed = getCurrentTimeInMs() - startTime;
+        clock = (clock > elapsed ? clock - elapsed : 0) + moveLimits.increment;
+        if (movesToGo && --movesToGo == 0) {
+            clock += limits.time;
+            movesToGo = limits.movesToGo;
+        }
+    }
+    cout << "bestmove " << Move{report.bestMove}.toString();
+    if (report.pv.size() > 1) cout << " ponder " << Move{report.pv[1]}.toString();
+    cout << endl;
+
+    int flag = chessBoard->makeMove(report.bestMove);
+    startPondering(*chessBoard, report.pv);
+    return flag;
+}
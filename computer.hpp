@@ -0,0 +1,34 @@
+#ifndef __COMPUTER_H__
+#define __COMPUTER_H__
+
+#include <thread>
+#include "board.hpp"
+#include "book.hpp"
+#include "player.hpp"
+#include "search.hpp"
+
+class Computer : public Player {
+    Search search;
+    SearchLimits limits;
+    OpeningBook book;
+    bool bookWeighted;
+    // remaining time and moves to the next time control, kept across moves
+    uint64_t clock;
+    int movesToGo;
+    // background search of the position after the expected reply
+    std::thread ponderThread;
+    Board ponderBoard;
+    SearchReport ponderReport;
+
+    void startPondering(const Board& board, const std::vector<EncMove>& pv);
+    void stopPondering();
+    void configureBook(const SearchOptions& options);
+public:
+    Computer(int side, const SearchOptions& options, const SearchLimits& limits);
+    ~Computer();
+    void configure(const SearchOptions& options, const SearchLimits& limits);
+    bool saveHash(const std::string& path);
+    virtual int move(Board* chessBoard, std::istringstream &ss) override;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#include <stdexcept>
+#include "engine.hpp"
+
+using namespace std;
+
+SearchHandle::State::State(const SearchOptions& options): search{options}, result{}, worker{} {}
+
+SearchHandle::State::~State() {
+    search.stop();
+    if (worker.joinable()) worker.join();
+}
+
+SearchHandle::SearchHandle(shared_ptr<State> state): state{state} {}
+
+void SearchHandle::cancel() {
+    state->search.stop();
+}
+
+bool SearchHandle::isDone() const {
+    return state->result.wait_for(chrono::seconds(0)) == future_status::ready;
+}
+
+shared_future<SearchReport> SearchHandle::result() const {
+    return state->result;
+}
+
+SearchReport SearchHandle::wait() const {
+    return state->result.get();
+}
+
+bool SearchHandle::saveHash(const string& path) const {
+    state->result.wait();
+    return state->search.saveHash(path);
+}
+
+Engine::Engine(const SearchOptions& options): options{options}, board{} {}
+
+void Engine::setOptions(const SearchOptions& newOptions) {
+    options = newOptions;
+}
+
+const SearchOptions& Engine::getOptions() const {
+    return options;
+}
+
+void Engine::setPosition(const string& fen, const vector<string>& moves) {
+    if (!Board::isValidFen(fen)) throw runtime_error("Invalid FEN: " + fen);
+    board.reset(fen);
+    for (const string& move : moves) {
+        if (!playMove(move)) throw runtime_error("Illegal move in position: " + move);
+    }
+}
+
+bool Engine::playMove(const string& move) {
+    if (move.size() < 4) return false;
+    string source = move.substr(0, 2), target = move.substr(2, 2);
+    char promote = move.size() > 4 ? move[4] : 'x';
+    return board.makeMove(source, target, promote) != ILLEGAL_MOVE;
+}
+
+void Engine::undoMove() {
+    board.undoMove();
+}
+
+const Board& Engine::getBoard() const {
+    return board;
+}
+
+vector<string> Engine::legalMoves() {
+    vector<string> moves;
+    for (EncMove move : board.generateLegalMoves(board.getSide())) moves.push_back(Move{move}.toString());
+    return moves;
+}
+
+GameStatus Engine::getStatus() {
+    return board.getGameStatus();
+}
+
+SearchHandle Engine::search(const SearchLimits& limits, ProgressCallback progress) const {
+    shared_ptr<SearchHandle::State> state{new SearchHandle::State{options}};
+    // the worker only sees the raw state, which joins the worker before it goes
+    Search* search = &state->search;
+    search->setProgressCallback(progress);
+    // prepared before the worker starts, so a cancel from here on is never lost
+    search->prepare(board, limits);
+    shared_ptr<promise<SearchReport>> report{new promise<SearchReport>};
+    state->result = report->get_future().share();
+    state->worker = thread([search, report]() {
+        try {
+            report->set_value(search->run());
+        } catch (...) {
+            report->set_exception(current_exception());
+        }
+    });
+    return SearchHandle{state};
+}
@@ -0,0 +1,58 @@
+#ifndef __ENGINE_H__
+#define __ENGINE_H__
+
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "board.hpp"
+#include "search.hpp"
+
+// A search running in the background. Handles are cheap to copy and share
+// the search; once the last one is dropped an unfinished search is
+// cancelled and its thread joined.
+class SearchHandle {
+    struct State {
+        Search search;
+        std::shared_future<SearchReport> result;
+        std::thread worker;
+        State(const SearchOptions& options);
+        ~State();
+    };
+    std::shared_ptr<State> state;
+
+    friend class Engine;
+    SearchHandle(std::shared_ptr<State> state);
+    public:
+        void cancel(); // the result still arrives, with the best move found so far
+        bool isDone() const;
+        std::shared_future<SearchReport> result() const;
+        SearchReport wait() const;
+        // waits for the search, then snapshots its table for SearchOptions::hashFile
+        bool saveHash(const std::string& path) const;
+};
+
+// In-process entry point for embedding the engine: set up a position, list
+// and play its moves, and start any number of concurrent searches on it.
+// Each search gets its own board copy, threads and transposition table.
+// Moves are in coordinate notation ("e2e4", "e7e8q").
+class Engine {
+    SearchOptions options;
+    Board board;
+    public:
+        Engine(const SearchOptions& options = SearchOptions());
+        void setOptions(const SearchOptions& options);
+        const SearchOptions& getOptions() const;
+
+        void setPosition(const std::string& fen = DEFAULT_FEN, const std::vector<std::string>& moves = {});
+        bool playMove(const std::string& move); // false, and nothing played, if illegal
+        void undoMove();
+        const Board& getBoard() const;
+        std::vector<std::string> legalMoves();
+        GameStatus getStatus();
+
+        SearchHandle search(const SearchLimits& limits, ProgressCallback progress = ProgressCallback()) const;
+};
+
+#endif
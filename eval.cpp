@@ -0,0 +1,173 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include "eval.hpp"
+#include "board.hpp"
+
+using namespace std;
+
+// middle game / end game weights of the pawn-structure terms
+const static int passedBonus[2][8] = {
+    {0, 5, 10, 15, 25, 40, 60, 0},
+    {0, 10, 20, 35, 60, 100, 150, 0}
+};
+const static int doubledPenalty[2] = {10, 20};
+const static int isolatedPenalty[2] = {10, 15};
+const static int backwardPenalty[2] = {8, 10};
+
+// per attacked square, indexed by knight, bishop, rook, queen
+const static int mobilityBonus[2][4] = {
+    {4, 3, 2, 1},
+    {4, 3, 4, 2}
+};
+const static int kingZonePenalty = 8;
+
+PawnHashTable::PawnHashTable(int sizeInKb): table{nullptr}, mask{0}, probes{0}, hits{0} {
+    size_t entries = 1;
+    while (entries * 2 * sizeof(PawnEntry) <= static_cast<size_t>(sizeInKb) * 1024) entries *= 2;
+    table = static_cast<PawnEntry*>(allocateLarge(entries * sizeof(PawnEntry)));
+    mask = entries - 1;
+}
+
+PawnHashTable::~PawnHashTable() {
+    freeLarge(table);
+}
+
+void PawnHashTable::clear() {
+    memset(static_cast<void*>(table), 0, (mask + 1) * sizeof(PawnEntry));
+    probes = hits = 0;
+}
+
+PawnEntry* PawnHashTable::probe(BitBoard key, bool& found) {
+    PawnEntry* entry = &table[key & mask];
+    ++probes;
+    found = entry->key == key;
+    if (found) ++hits;
+    return entry;
+}
+
+Evaluator::Evaluator(int pawnHashKb): pawnHash{pawnHashKb} {}
+
+void Evaluator::clear() {
+    pawnHash.clear();
+}
+
+const PawnHashTable& Evaluator::getPawnHash() const {
+    return pawnHash;
+}
+
+void Evaluator::evaluatePawns(Board& board, PawnEntry& entry) {
+    BitBoard pawns[2] = {board.getPieceBB('P'), board.getPieceBB('p')};
+    BitBoard front[2] = {northFill(pawns[WHITE_SIDE] >> 8), southFill(pawns[BLACK_SIDE] << 8)};
+    BitBoard attacks[2] = {pawnAttacksSetwise(WHITE_SIDE, pawns[WHITE_SIDE]), pawnAttacksSetwise(BLACK_SIDE, pawns[BLACK_SIDE])};
+    BitBoard behind[2] = {southFill(pawns[WHITE_SIDE] << 8), northFill(pawns[BLACK_SIDE] >> 8)};
+    BitBoard stops[2] = {pawns[WHITE_SIDE] >> 8, pawns[BLACK_SIDE] << 8};
+
+    entry.attackSpan[WHITE_SIDE] = northFill(attacks[WHITE_SIDE]);
+    entry.attackSpan[BLACK_SIDE] = southFill(attacks[BLACK_SIDE]);
+    entry.mgScore = entry.egScore = 0;
+
+    for (int side = WHITE_SIDE; side <= BLACK_SIDE; ++side) {
+        int opp = side ^ 1, sign = side == WHITE_SIDE ? 1 : -1;
+        BitBoard files = fileFill(pawns[side]);
+        BitBoard adjacentFiles = ((files << 1) & NOT_A_FILE) | ((files >> 1) & NOT_H_FILE);
+
+        BitBoard passed = pawns[side] & ~(front[opp] | entry.attackSpan[opp]);
+        BitBoard doubled = pawns[side] & behind[side];
+        BitBoard isolated = pawns[side] & ~adjacentFiles;
+        BitBoard backwardStops = stops[side] & attacks[opp] & ~entry.attackSpan[side];
+        BitBoard backward = side == WHITE_SIDE ? backwardStops << 8 : backwardStops >> 8;
+        entry.passed[side] = passed;
+
+        while (passed) {
+            int square = getLSBIndex(passed);
+            int rank = side == WHITE_SIDE ? 7 - square / BOARD_WIDTH : square / BOARD_WIDTH;
+            entry.mgScore += sign * passedBonus[0][rank];
+            entry.egScore += sign * passedBonus[1][rank];
+            popBit(passed, square);
+        }
+        entry.mgScore -= sign * (countBits(doubled) * doubledPenalty[0] + countBits(isolated) * isolatedPenalty[0] + countBits(backward) * backwardPenalty[0]);
+        entry.egScore -= sign * (countBits(doubled) * doubledPenalty[1] + countBits(isolated) * isolatedPenalty[1] + countBits(backward) * backwardPenalty[1]);
+    }
+}
+
+PawnEntry* Evaluator::probePawns(Board& board) {
+    bool found;
+    BitBoard key = board.getPawnKey();
+    PawnEntry* entry = pawnHash.probe(key, found);
+    if (!found) {
+        evaluatePawns(board, *entry);
+        entry->key = key;
+    }
+    return entry;
+}
+
+int Evaluator::evaluate(Board& board) {
+    int mg = 0, eg = 0, phaseScore = 0;
+
+    for (int i = 0; i < PIECES; ++i) {
+        char piece = pieces[i];
+        BitBoard bitboard = board.getPieceBB(piece);
+        int count = countBits(bitboard);
+        mg += count * materialScores[opening][i];
+        eg += count * materialScores[endgame][i];
+        if (i % 6 != 0 && i % 6 != 5) phaseScore += count * abs(materialScores[opening][i]);
+
+        int sign = i < 6 ? 1 : -1;
+        while (bitboard) {
+            int square = getLSBIndex(bitboard);
+            int pstSquare = i < 6 ? square : square ^ 56; // mirror ranks for black
+            switch (i % 6) {
+                case 0: mg += sign * pawnTable[pstSquare]; eg += sign * pawnTable[pstSquare]; break;
+                case 1: mg += sign * knightTable[pstSquare]; eg += sign * knightTable[pstSquare]; break;
+                case 2: mg += sign * bishopTable[pstSquare]; eg += sign * bishopTable[pstSquare]; break;
+                case 5: mg += sign * kingTable[pstSquare]; break;
+            }
+            popBit(bitboard, square);
+        }
+    }
+
+    PawnEntry* pawns = probePawns(board);
+    mg += pawns->mgScore;
+    eg += pawns->egScore;
+
+    for (int side = WHITE_SIDE; side <= BLACK_SIDE; ++side) {
+        int sign = side == WHITE_SIDE ? 1 : -1;
+        BitBoard own = board.getOccupancyBySide(side);
+        BitBoard enemyPawnAttacks = pawnAttacksSetwise(side ^ 1, board.getPieceBB(side == WHITE_SIDE ? 'p' : 'P'));
+        for (int i = 1; i <= 4; ++i) {
+            BitBoard attacks = board.getPieceAttackMap(pieces[side * 6 + i]) & ~own & ~enemyPawnAttacks;
+            mg += sign * countBits(attacks) * mobilityBonus[0][i - 1];
+            eg += sign * countBits(attacks) * mobilityBonus[1][i - 1];
+        }
+
+        BitBoard king = board.getPieceBB(side == WHITE_SIDE ? 'K' : 'k');
+        if (king) {
+            BitBoard kingZone = board.getPieceAttackMap(side == WHITE_SIDE ? 'K' : 'k') | king;
+            mg -= sign * countBits(board.getAttackMap(side ^ 1) & kingZone) * kingZonePenalty;
+        }
+    }
+
+    int score;
+    if (phaseScore > openingPhaseScore) score = mg;
+    else if (phaseScore < endgamePhaseScore) score = eg;
+    else score = (mg * phaseScore + eg * (openingPhaseScore - phaseScore)) / openingPhaseScore;
+
+    return board.getSide() == WHITE_SIDE ? score : -score;
+}
+
+void Evaluator::print(Board& board) {
+    PawnEntry* pawns = probePawns(board);
+    cout << "pawns (mg/eg): " << pawns->mgScore << " / " << pawns->egScore << endl;
+    cout << "passed: ";
+    for (int side = WHITE_SIDE; side <= BLACK_SIDE; ++side) {
+        BitBoard passed = pawns->passed[side];
+        while (passed) {
+            int square = getLSBIndex(passed);
+            cout << positions[square] << " ";
+            popBit(passed, square);
+        }
+    }
+    cout << endl;
+    cout << "eval: " << evaluate(board) << " (side to move)" << endl;
+}
@@ -0,0 +1,50 @@
+#ifndef __EVAL_H__
+#define __EVAL_H__
+
+#include <vector>
+#include "memory.hpp"
+#include "util.hpp"
+
+class Board;
+
+// Pawn-structure terms only depend on the pawn bitboards, so they are cached
+// under the board's pawn-only Zobrist key and reused until a pawn moves.
+struct PawnEntry {
+    BitBoard key;
+    int mgScore, egScore;      // white minus black
+    BitBoard passed[2];        // passed pawns per side
+    BitBoard attackSpan[2];    // squares each side's pawns can ever attack
+};
+
+// Allocated on huge pages where the system allows it. A zeroed entry is the
+// correct one for the pawnless key 0, so a fresh table needs no clearing and
+// its pages are first touched by the search thread that owns it.
+class PawnHashTable {
+    PawnEntry* table;
+    BitBoard mask;
+    public:
+        uint64_t probes, hits;
+
+        PawnHashTable(int sizeInKb = 1024);
+        ~PawnHashTable();
+        PawnHashTable(const PawnHashTable&) = delete;
+        PawnHashTable& operator=(const PawnHashTable&) = delete;
+        void clear();
+        PawnEntry* probe(BitBoard key, bool& found);
+};
+
+class Evaluator {
+    PawnHashTable pawnHash;
+
+    void evaluatePawns(Board& board, PawnEntry& entry);
+    public:
+        Evaluator(int pawnHashKb = 1024);
+
+        PawnEntry* probePawns(Board& board);
+        int evaluate(Board& board); // centipawns, from the side to move
+        void clear();
+        const PawnHashTable& getPawnHash() const;
+        void print(Board& board);
+};
+
+#endif
@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "explorer.hpp"
+#include "archive.hpp"
+#include "pgn.hpp"
+
+using namespace std;
+
+#define EXPLORER_MAGIC "CHESSEX2"
+#define EXPLORER_HEADER_SIZE 16
+
+static_assert(sizeof(ExplorerEntry) == 24, "explorer entries are written as raw 24-byte records");
+
+static bool entryLess(const ExplorerEntry& a, const ExplorerEntry& b) {
+    return a.key != b.key ? a.key < b.key : a.move < b.move;
+}
+
+ExplorerIndex::ExplorerIndex(): entries{nullptr}, count{0}, size{0} {}
+
+ExplorerIndex::~ExplorerIndex() {
+    close();
+}
+
+void ExplorerIndex::close() {
+    if (entries) munmap(reinterpret_cast<char*>(const_cast<ExplorerEntry*>(entries)) - EXPLORER_HEADER_SIZE, size);
+    entries = nullptr;
+    count = size = 0;
+}
+
+bool ExplorerIndex::open(const string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) < 0 || info.st_size < EXPLORER_HEADER_SIZE) {
+        ::close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) return false;
+    const char* data = static_cast<const char*>(mapped);
+    uint64_t entryCount;
+    memcpy(&entryCount, data + 8, sizeof(entryCount));
+    if (memcmp(data, EXPLORER_MAGIC, 8) != 0 ||
+        entryCount != (info.st_size - EXPLORER_HEADER_SIZE) / sizeof(ExplorerEntry)) {
+        munmap(mapped, info.st_size);
+        return false;
+    }
+    // positions are looked up at random, read-ahead would only waste I/O
+    madvise(mapped, info.st_size, MADV_RANDOM);
+    entries = reinterpret_cast<const ExplorerEntry*>(data + EXPLORER_HEADER_SIZE);
+    count = entryCount;
+    size = info.st_size;
+    return true;
+}
+
+uint64_t ExplorerIndex::getCount() const {
+    return count;
+}
+
+vector<ExplorerEntry> ExplorerIndex::lookup(BitBoard key) const {
+    ExplorerEntry probe{key, {0, 0, 0}, 0, 0};
+    const ExplorerEntry* first = lower_bound(entries, entries + count, probe, entryLess);
+    vector<ExplorerEntry> moves;
+    for (const ExplorerEntry* entry = first; entry < entries + count && entry->key == key; ++entry) {
+        moves.push_back(*entry);
+    }
+    sort(moves.begin(), moves.end(), [](const ExplorerEntry& a, const ExplorerEntry& b) { return a.games() > b.games(); });
+    return moves;
+}
+
+// sorts the samples and folds equal (key, move) pairs together
+static void compact(vector<ExplorerEntry>& samples) {
+    sort(samples.begin(), samples.end(), entryLess);
+    size_t out = 0;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        if (out > 0 && samples[out - 1].key == samples[i].key && samples[out - 1].move == samples[i].move) {
+            for (int r = 0; r < 3; ++r) samples[out - 1].results[r] += samples[i].results[r];
+        } else {
+            samples[out++] = samples[i];
+        }
+    }
+    samples.resize(out);
+}
+
+// One builder thread's samples, spilled whenever the buffer fills up.
+struct ExplorerCollector {
+    vector<ExplorerEntry> samples;
+    Board board;
+    uint64_t games = 0, recorded = 0;
+};
+
+class ExplorerBuilder {
+    string path;
+    int maxPly;
+    size_t capacity;
+    mutex runsMutex;
+    vector<string> runs;
+    // the first error of any builder thread, rethrown once they are all done
+    exception_ptr error;
+    atomic<bool> failed;
+
+    public:
+        ExplorerBuilder(const string& path, int maxPly, size_t capacity):
+            path{path}, maxPly{maxPly}, capacity{capacity}, runsMutex{}, runs{}, error{}, failed{false} {}
+
+        void fail(exception_ptr e) {
+            lock_guard<mutex> lock{runsMutex};
+            if (!error) error = e;
+            failed = true;
+        }
+
+        bool hasFailed() const { return failed; }
+
+        void rethrowFailure() {
+            lock_guard<mutex> lock{runsMutex};
+            if (error) rethrow_exception(error);
+        }
+
+        void removeRuns() {
+            lock_guard<mutex> lock{runsMutex};
+            for (const string& run : runs) remove(run.c_str());
+            runs.clear();
+        }
+
+        void spill(ExplorerCollector& collector) {
+            if (collector.samples.empty()) return;
+            compact(collector.samples);
+            string run;
+            {
+                lock_guard<mutex> lock{runsMutex};
+                run = path + ".run" + to_string(runs.size());
+                runs.push_back(run);
+            }
+            ofstream out{run, ios::binary};
+            out.write(reinterpret_cast<const char*>(collector.samples.data()), collector.samples.size() * sizeof(ExplorerEntry));
+            out.close();
+            if (!out) throw runtime_error("Could not write explorer run: " + run);
+            collector.samples.clear();
+        }
+
+        void add(ExplorerCollector& collector, const PgnGame& game) {
+            int result = game.result == "1-0" ? 0 : game.result == "1/2-1/2" ? 1 : game.result == "0-1" ? 2 : -1;
+            if (result < 0 || !game.error.empty()) return;
+            collector.board.reset(game.fen);
+            for (size_t ply = 0; ply < game.moves.size() && static_cast<int>(ply) < maxPly; ++ply) {
+                ExplorerEntry sample{collector.board.getPositionKey(), {0, 0, 0}, game.moves[ply], 0};
+                sample.results[result] = 1;
+                collector.samples.push_back(sample);
+                if (collector.samples.size() >= capacity) spill(collector);
+                collector.board.makeMove(game.moves[ply]);
+                ++collector.recorded;
+            }
+            ++collector.games;
+        }
+
+        // k-way merge of the sorted runs into the index; returns the entry count
+        uint64_t merge() {
+            struct Cursor {
+                ifstream in;
+                ExplorerEntry entry;
+                bool next() { return static_cast<bool>(in.read(reinterpret_cast<char*>(&entry), sizeof(entry))); }
+            };
+            vector<unique_ptr<Cursor>> cursors;
+            for (const string& run : runs) {
+                cursors.emplace_back(new Cursor{ifstream{run, ios::binary}, ExplorerEntry{}});
+            }
+            auto later = [&](size_t a, size_t b) { return entryLess(cursors[b]->entry, cursors[a]->entry); };
+            priority_queue<size_t, vector<size_t>, decltype(later)> heap{later};
+            for (size_t i = 0; i < cursors.size(); ++i) {
+                if (cursors[i]->next()) heap.push(i);
+            }
+
+            ofstream out{path, ios::binary};
+            if (!out) throw runtime_error("Could not write explorer index: " + path);
+            uint64_t written = 0;
+            out.write(EXPLORER_MAGIC, 8);
+            out.write(reinterpret_cast<const char*>(&written), sizeof(written));
+            ExplorerEntry pending{};
+            bool hasPending = false;
+            while (!heap.empty()) {
+                size_t i = heap.top();
+                heap.pop();
+                const ExplorerEntry& entry = cursors[i]->entry;
+                if (hasPending && pending.key == entry.key && pending.move == entry.move) {
+                    for (int r = 0; r < 3; ++r) pending.results[r] += entry.results[r];
+                } else {
+                    if (hasPending) {
+                        out.write(reinterpret_cast<const char*>(&pending), sizeof(pending));
+                        ++written;
+                    }
+                    pending = entry;
+                    hasPending = true;
+                }
+                if (cursors[i]->next()) heap.push(i);
+            }
+            if (hasPending) {
+                out.write(reinterpret_cast<const char*>(&pending), sizeof(pending));
+                ++written;
+            }
+            out.seekp(8);
+            out.write(reinterpret_cast<const char*>(&written), sizeof(written));
+            out.close();
+            if (!out) {
+                remove(path.c_str());
+                throw runtime_error("Could not write explorer index: " + path);
+            }
+
+            cursors.clear();
+            for (const string& run : runs) remove(run.c_str());
+            return written;
+        }
+
+        int runCount() const { return runs.size(); }
+};
+
+ExplorerBuildStats buildExplorerIndex(const string& corpus, const string& path, int threads, int maxPly, int memoryMb) {
+    uint64_t startTime = getCurrentTimeInMs();
+    threads = max(1, threads);
+    size_t capacity = max<size_t>(1024, static_cast<size_t>(memoryMb) * 1024 * 1024 / threads / sizeof(ExplorerEntry));
+    ExplorerBuilder builder{path, maxPly, capacity};
+    vector<unique_ptr<ExplorerCollector>> collectors;
+
+    // a failed spill, e.g. on a full disk, stops every thread and is rethrown here
+    auto addGame = [&](ExplorerCollector& collector, const PgnGame& game) {
+        try {
+            builder.add(collector, game);
+        } catch (...) {
+            builder.fail(current_exception());
+        }
+    };
+
+    ArchiveReader archive;
+    PgnReader pgn;
+    if (archive.open(corpus)) {
+        for (int i = 0; i < threads; ++i) collectors.emplace_back(new ExplorerCollector);
+        atomic<uint64_t> next{0};
+        auto work = [&](ExplorerCollector* collector) {
+            for (uint64_t game = next++; game < archive.count() && !builder.hasFailed(); game = next++) {
+                PgnGame read;
+                try {
+                    read = archive.read(game, collector->board);
+                } catch (const runtime_error&) {
+                    continue; // a corrupt game is skipped like a PGN game that fails to replay
+                }
+                addGame(*collector, read);
+            }
+        };
+        vector<thread> workers;
+        for (int i = 1; i < threads; ++i) workers.emplace_back(work, collectors[i].get());
+        work(collectors[0].get());
+        for (auto& worker : workers) worker.join();
+    } else if (pgn.open(corpus)) {
+        // the reader's threads are its own, each gets a collector on its first game
+        mutex collectorsMutex;
+        map<thread::id, ExplorerCollector*> byThread;
+        pgn.replay(threads, PgnMoveCallback(), [&](const PgnGame& game) {
+            if (builder.hasFailed()) return;
+            ExplorerCollector* collector;
+            {
+                lock_guard<mutex> lock{collectorsMutex};
+                ExplorerCollector*& slot = byThread[this_thread::get_id()];
+                if (!slot) {
+                    collectors.emplace_back(new ExplorerCollector);
+                    slot = collectors.back().get();
+                }
+                collector = slot;
+            }
+            addGame(*collector, game);
+        });
+    } else {
+        throw runtime_error("Could not open corpus: " + corpus);
+    }
+
+    ExplorerBuildStats stats{0, 0, 0, 0, 0};
+    try {
+        builder.rethrowFailure();
+        for (auto& collector : collectors) {
+            builder.spill(*collector);
+            stats.games += collector->games;
+            stats.samples += collector->recorded;
+        }
+        stats.runs = builder.runCount();
+        stats.entries = builder.merge();
+    } catch (...) {
+        builder.removeRuns();
+        throw;
+    }
+    stats.timeMs = getCurrentTimeInMs() - startTime;
+    return stats;
+}
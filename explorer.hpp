@@ -0,0 +1,54 @@
+#ifndef __EXPLORER_H__
+#define __EXPLORER_H__
+
+#include <string>
+#include <vector>
+#include "board.hpp"
+
+// One move played from one position, with the results of the games that
+// played it. The index file is "CHESSEX2", a u64 entry count, then the
+// entries sorted by key and move, so all moves of a position are adjacent.
+struct ExplorerEntry {
+    uint64_t key;     // Board::getPositionKey of the position before the move
+    uint32_t results[3]; // white wins, draws, black wins
+    uint16_t move;
+    uint16_t padding;
+
+    uint64_t games() const { return static_cast<uint64_t>(results[0]) + results[1] + results[2]; }
+};
+
+struct ExplorerBuildStats {
+    uint64_t games, samples, entries;
+    int runs;
+    uint64_t timeMs;
+};
+
+// Memory-mapped explorer index: opening it reads nothing, and a lookup is a
+// binary search touching O(log n) pages.
+class ExplorerIndex {
+    const ExplorerEntry* entries;
+    uint64_t count;
+    size_t size;
+
+    void close();
+    public:
+        ExplorerIndex();
+        ~ExplorerIndex();
+        ExplorerIndex(const ExplorerIndex&) = delete;
+        ExplorerIndex& operator=(const ExplorerIndex&) = delete;
+
+        bool open(const std::string& path);
+        uint64_t getCount() const;
+        // every move seen from the position, most played first
+        std::vector<ExplorerEntry> lookup(BitBoard key) const;
+};
+
+// Replays a PGN file or game archive on several threads and records every
+// (position, move, result) of the first maxPly plies of decided games. Each
+// thread sorts and merges its samples in a buffer of its share of memoryMb
+// and spills it as a sorted run next to the output; the runs are then
+// merged into the index, so the corpus may be far larger than memory.
+ExplorerBuildStats buildExplorerIndex(const std::string& corpus, const std::string& path, int threads, int maxPly,
+                                      int memoryMb);
+
+#endif
@@ -1,33 +1,171 @@
+#include <chrono>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <thread>
 
 #include "board.hpp"
 #include "player.hpp"
 #include "human.hpp"
+#include "computer.hpp"
+#include "eval.hpp"
+#include "bench.hpp"
+#include "perft.hpp"
+#include "bitbase.hpp"
+#include "server.hpp"
+#include "pgn.hpp"
+#include "archive.hpp"
+#include "explorer.hpp"
+#include "memory.hpp"
+#include "mcts.hpp"
+#include "mate.hpp"
 
 using namespace std;
 
 class Controller{
-    Board* chessBoard;
+    unique_ptr<Board> chessBoard;
     vector<Player*> players;
+    Evaluator evaluator;
+    SearchOptions searchOptions;
+    SearchLimits searchLimits;
+    MateOptions mateOptions;
+    Bitbases bitbases;
+    bool adjudicate; // end games the loaded bitbases already decide
     bool isGameSetup;
 
+    Player* createPlayer(string& type, int side) {
+        if (type == "computer") return new Computer(side, searchOptions, searchLimits);
+        if (type == "mcts") return new MctsPlayer(side, searchOptions, searchLimits);
+        return new Human(side);
+    }
+
     void setupPlayers(istringstream& ss) {
+        for (auto player : players) delete player;
         players.resize(2);
         string white, black;
         ss >> white;
         ss >> black;
-        players[0] = new Human(WHITE_SIDE);
-        players[1] = new Human(BLACK_SIDE);
+        players[0] = createPlayer(white, WHITE_SIDE);
+        players[1] = createPlayer(black, BLACK_SIDE);
+    }
+
+    void handleOption(istringstream& ss) {
+        string name;
+        ss >> name;
+        if (name == "threads") ss >> searchOptions.threads;
+        else if (name == "hash") ss >> searchOptions.hashMb;
+        else if (name == "hashfile") ss >> searchOptions.hashFile;
+        else if (name == "numa") setNumaPolicy(ss);
+        else if (name == "pin") ss >> searchOptions.pinThreads;
+        else if (name == "info") ss >> searchOptions.showInfo;
+        else if (name == "ponder") ss >> searchOptions.ponder;
+        else if (name == "multipv") ss >> searchOptions.multiPv;
+        else if (name == "qchecks") ss >> searchOptions.quietChecks;
+        else if (name == "stats") ss >> searchOptions.statsFile;
+        else if (name == "book") ss >> searchOptions.bookFile;
+        else if (name == "bookrandoms") ss >> searchOptions.bookRandoms;
+        else if (name == "bookweighted") ss >> searchOptions.bookWeighted;
+        else if (name == "bitbases") loadBitbases(ss);
+        else if (name == "adjudicate") ss >> adjudicate;
+        else if (name == "nullmove") ss >> searchOptions.pruning.nullMove;
+        else if (name == "nullmove_reduction") ss >> searchOptions.pruning.nullMoveReduction;
+        else if (name == "lmr") ss >> searchOptions.pruning.lmr;
+        else if (name == "lmr_depth") ss >> searchOptions.pruning.lmrMinDepth;
+        else if (name == "lmr_moves") ss >> searchOptions.pruning.lmrMinMoves;
+        else if (name == "rfp") ss >> searchOptions.pruning.reverseFutility;
+        else if (name == "rfp_depth") ss >> searchOptions.pruning.reverseFutilityDepth;
+        else if (name == "rfp_margin") ss >> searchOptions.pruning.reverseFutilityMargin;
+        else if (name == "futility") ss >> searchOptions.pruning.futility;
+        else if (name == "futility_depth") ss >> searchOptions.pruning.futilityDepth;
+        else if (name == "futility_margin") ss >> searchOptions.pruning.futilityMargin;
+        else if (name == "razoring") ss >> searchOptions.pruning.razoring;
+        else if (name == "razor_depth") ss >> searchOptions.pruning.razorDepth;
+        else if (name == "razor_margin") ss >> searchOptions.pruning.razorMargin;
+        else if (name == "mcts_puct") ss >> searchOptions.mcts.puct;
+        else if (name == "mcts_exploration") ss >> searchOptions.mcts.exploration;
+        else if (name == "mcts_quiescence") ss >> searchOptions.mcts.quiescence;
+        else if (name == "mcts_reuse") ss >> searchOptions.mcts.reuseTree;
+        else if (name == "mcts_memory") ss >> searchOptions.mcts.arenaMb;
+        else if (name == "mate_checks") ss >> mateOptions.checksOnly;
+        else if (name == "mate_nodes") ss >> mateOptions.maxNodes;
+        else if (name == "mate_memory") ss >> mateOptions.tableMb;
+        else if (name == "depth") ss >> searchLimits.depth;
+        else if (name == "movetime") ss >> searchLimits.movetime;
+        else if (name == "nodes") ss >> searchLimits.nodes;
+        else if (name == "time") ss >> searchLimits.time;
+        else if (name == "inc") ss >> searchLimits.increment;
+        else if (name == "movestogo") ss >> searchLimits.movesToGo;
+        else if (name == "infinite") ss >> searchLimits.infinite;
+        else throw runtime_error("Unknown option: " + name);
+
+        for (auto player : players) {
+            Computer* computer = dynamic_cast<Computer*>(player);
+            if (computer) computer->configure(searchOptions, searchLimits);
+            MctsPlayer* mcts = dynamic_cast<MctsPlayer*>(player);
+            if (mcts) mcts->configure(searchOptions, searchLimits);
+        }
+    }
+
+    // numa default|interleave|local
+    void setNumaPolicy(istringstream& ss) {
+        string policy;
+        ss >> policy;
+        if (policy == "default") searchOptions.numa = NUMA_DEFAULT;
+        else if (policy == "interleave") searchOptions.numa = NUMA_INTERLEAVE;
+        else if (policy == "local") searchOptions.numa = NUMA_LOCAL;
+        else throw runtime_error("Unknown NUMA policy: " + policy);
+    }
+
+    void loadBitbases(istringstream& ss) {
+        string dir;
+        ss >> dir;
+        int loaded = bitbases.load(dir);
+        searchOptions.bitbases = loaded ? &bitbases : nullptr;
+        cout << "Loaded " << loaded << " bitbases from " << dir << endl;
+    }
+
+    void playMove(istringstream& ss) {
+        int side = chessBoard->getSide();
+        players[side]->move(chessBoard.get(), ss);
+        GameStatus status = chessBoard->getGameStatus();
+        updateGameState(side, status);
+        if (adjudicate && !status.isOver()) adjudicateGame();
+        chessBoard->render();
     }
 
-    void updateGameState(int side, int flag) {
-        switch(flag) {
-            case GAME_OVER:
-                isGameSetup = false;
+    void adjudicateGame() {
+        int result;
+        if (!bitbases.probe(*chessBoard, result)) return;
+        isGameSetup = false;
+        if (result == 0) {
+            cout << "Draw by bitbase adjudication!" << endl;
+        } else {
+            int winner = result > 0 ? chessBoard->getSide() : chessBoard->getSide() ^ 1;
+            cout << "Bitbase adjudication! " << (winner == WHITE_SIDE ? "White" : "Black") << " won!" << endl;
+        }
+    }
+
+    void updateGameState(int side, const GameStatus& status) {
+        if (status.isOver()) isGameSetup = false;
+        switch(status.termination) {
+            case ONGOING:
+                if (status.inCheck) cout << "Check!" << endl;
+                break;
+            case CHECKMATE:
                 cout << "Checkmate! " << (side == WHITE_SIDE ? "White" : "Black") << " won!" << endl;
                 break;
-            case DRAW:
-                cout << "Draw!" << endl;
+            case STALEMATE:
+                cout << "Draw by stalemate!" << endl;
+                break;
+            case FIFTY_MOVE_RULE:
+                cout << "Draw by the fifty-move rule!" << endl;
+                break;
+            case THREEFOLD_REPETITION:
+                cout << "Draw by threefold repetition!" << endl;
+                break;
+            case INSUFFICIENT_MATERIAL:
+                cout << "Draw by insufficient material!" << endl;
                 break;
         }
     }
@@ -37,10 +175,12 @@ class Controller{
         Player* curPlayer = players[side];
 
         if (command == "move") {
-            curPlayer->move(chessBoard, ss);
-            int flag = chessBoard->checkGameState(side ^ 1);
-            updateGameState(side, flag);
-            chessBoard->render();
+            playMove(ss);
+            // an engine answers a human move straight away
+            if (isGameSetup && dynamic_cast<Human*>(curPlayer) && !dynamic_cast<Human*>(players[side ^ 1])) {
+                istringstream none;
+                playMove(none);
+            }
         } else if (command == "undo") {
             int num = 1;
             if (!ss.str().empty()) {
@@ -50,8 +190,10 @@ class Controller{
                 chessBoard->undoMove();
             }
             chessBoard->render();
+        } else if (command == "eval") {
+            evaluator.print(*chessBoard);
         } else if (command == "forfeit") {
-            updateGameState(side, GAME_OVER);
+            updateGameState(side, GameStatus{CHECKMATE, false});
         } else {
             throw runtime_error("Command not recognized, try again!"); 
         }
@@ -61,13 +203,196 @@ class Controller{
         if (command != "game" && command != "load") {
             throw runtime_error("Command not recognized, try again!"); 
         }
-        chessBoard = new Board();
         setupPlayers(ss);
+        if (command == "load") {
+            string fen;
+            getline(ss >> ws, fen);
+            if (!Board::isValidFen(fen)) throw runtime_error("Invalid FEN: " + fen);
+            chessBoard.reset(new Board(fen));
+        } else {
+            chessBoard.reset(new Board());
+        }
         isGameSetup = true;
         chessBoard->render();
     }
 
     public:
+        ~Controller() {
+            for (auto player : players) delete player;
+        }
+
+        // bench [depth] [threads] [pruning]: the node count is only reproducible with one thread
+        void bench(istringstream& ss) {
+            int depth = 5;
+            string mode;
+            SearchOptions options = searchOptions;
+            options.threads = 1;
+            ss >> depth >> options.threads >> mode;
+            if (mode == "pruning") {
+                runPruningBench(depth, options, cout);
+            } else {
+                runBench(depth, options, cout);
+            }
+        }
+
+        // perft <depth> [fen]: the running game's position unless a FEN is given;
+        // uses the threads and hash options of the search
+        void perft(istringstream& ss) {
+            int depth = 5;
+            string fen;
+            ss >> depth;
+            getline(ss >> ws, fen);
+            if (!fen.empty() && !Board::isValidFen(fen)) throw runtime_error("Invalid FEN: " + fen);
+            Board board = !fen.empty() ? Board{fen} : (isGameSetup ? *chessBoard : Board{});
+            runPerft(board, depth, searchOptions.threads, searchOptions.hashMb, cout);
+        }
+
+        // bitbase <dir> [threads]: builds every supported ending and writes it to dir
+        void generateBitbases(istringstream& ss) {
+            string dir = ".";
+            int threads = searchOptions.threads;
+            ss >> dir >> threads;
+            bitbases.generate(dir, threads, cout);
+            searchOptions.bitbases = &bitbases;
+        }
+
+        // pgn <file> [threads]: replays every game of a PGN database and reports the throughput
+        void replayPgn(istringstream& ss) {
+            string path;
+            int threads = searchOptions.threads;
+            ss >> path >> threads;
+            PgnReader reader;
+            if (!reader.open(path)) throw runtime_error("Could not open PGN: " + path);
+            PgnStats stats = reader.replay(threads);
+            cout << "Games           : " << stats.games << endl
+                 << "Moves           : " << stats.moves << endl
+                 << "Unresolved games: " << stats.errors << endl
+                 << "Time (ms)       : " << stats.timeMs << endl
+                 << "Moves/second    : " << stats.moves * 1000 / (stats.timeMs ? stats.timeMs : 1) << endl;
+        }
+
+        // archive pack <pgn> <archive> | archive unpack <archive> <pgn>
+        void convertArchive(istringstream& ss) {
+            string mode, source, target;
+            ss >> mode >> source >> target;
+            uint64_t startTime = getCurrentTimeInMs(), games = 0, skipped = 0;
+            if (mode == "pack") {
+                PgnReader reader;
+                ArchiveWriter writer;
+                if (!reader.open(source)) throw runtime_error("Could not open PGN: " + source);
+                if (!writer.open(target)) throw runtime_error("Could not create archive: " + target);
+                // one thread keeps the archive in the order of the PGN
+                reader.replay(1, PgnMoveCallback(), [&](const PgnGame& game) {
+                    if (game.error.empty() && writer.write(game)) ++games;
+                    else ++skipped;
+                });
+                if (!writer.close()) throw runtime_error("Could not write archive: " + target);
+            } else if (mode == "unpack") {
+                ArchiveReader reader;
+                if (!reader.open(source)) throw runtime_error("Could not open archive: " + source);
+                ofstream out{target};
+                for (; games < reader.count(); ++games) writePgn(reader.read(games), out);
+                if (!out) throw runtime_error("Could not write PGN: " + target);
+            } else {
+                throw runtime_error("Usage: archive pack <pgn> <archive> | archive unpack <archive> <pgn>");
+            }
+            cout << games << " games, " << skipped << " skipped, " << getCurrentTimeInMs() - startTime << " ms" << endl;
+        }
+
+        // explorer build <pgn|archive> <index> [threads] [maxply] [memoryMb] | explorer probe <index> [fen]
+        void explore(istringstream& ss) {
+            string mode, path;
+            ss >> mode;
+            if (mode == "build") {
+                string corpus;
+                int threads = searchOptions.threads, maxPly = 40, memoryMb = 256;
+                ss >> corpus >> path >> threads >> maxPly >> memoryMb;
+                ExplorerBuildStats stats = buildExplorerIndex(corpus, path, threads, maxPly, memoryMb);
+                cout << "Games           : " << stats.games << endl
+                     << "Positions       : " << stats.samples << endl
+                     << "Entries         : " << stats.entries << endl
+                     << "Sorted runs     : " << stats.runs << endl
+                     << "Time (ms)       : " << stats.timeMs << endl;
+            } else if (mode == "probe") {
+                string fen;
+                ss >> path;
+                getline(ss >> ws, fen);
+                if (!fen.empty() && !Board::isValidFen(fen)) throw runtime_error("Invalid FEN: " + fen);
+                ExplorerIndex index;
+                if (!index.open(path)) throw runtime_error("Could not open explorer index: " + path);
+                Board board = !fen.empty() ? Board{fen} : (isGameSetup ? *chessBoard : Board{});
+                auto start = chrono::steady_clock::now();
+                vector<ExplorerEntry> moves = index.lookup(board.getPositionKey());
+                auto micros = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+                for (const ExplorerEntry& entry : moves) {
+                    cout << setw(8) << left << board.toSan(entry.move) << right << setw(10) << entry.games()
+                         << "  +" << entry.results[0] << " =" << entry.results[1] << " -" << entry.results[2] << endl;
+                }
+                cout << moves.size() << " moves from " << index.getCount() << " entries in " << micros << " us" << endl;
+            } else {
+                throw runtime_error("Usage: explorer build <pgn|archive> <index> [threads] [maxply] [memoryMb] | explorer probe <index> [fen]");
+            }
+        }
+
+        // mate <epd> [threads] [maxmoves]: solves a file of mate puzzles
+        // mate <maxmoves> [fen]: one position, the running game's by default
+        void solveMate(istringstream& ss) {
+            string target;
+            ss >> target;
+            if (target.empty()) throw runtime_error("Usage: mate <epd> [threads] [maxmoves] | mate <maxmoves> [fen]");
+            MateOptions options = mateOptions;
+            // a count only when the whole token is digits, so "3mates.epd" is still a file
+            if (target.size() <= 3 && target.find_first_not_of("0123456789") == string::npos) {
+                string fen;
+                options.maxMoves = stoi(target);
+                getline(ss >> ws, fen);
+                if (!fen.empty() && !Board::isValidFen(fen)) throw runtime_error("Invalid FEN: " + fen);
+                Board board = !fen.empty() ? Board{fen} : (isGameSetup ? *chessBoard : Board{});
+                MateSolver solver{options};
+                MateResult result = solver.solve(board);
+                if (result.mateIn) cout << "Mate in " << result.mateIn << ": " << board.toSan(result.keyMove);
+                else cout << (result.aborted ? "Node limit reached" : "No mate found");
+                cout << " (" << result.nodes << " nodes, " << result.timeMs << " ms)" << endl;
+                return;
+            }
+            int threads = max(1u, thread::hardware_concurrency());
+            ss >> threads >> options.maxMoves;
+            MateBatchStats stats = solveEpd(readEpd(target), threads, options, cout);
+            cout << "Positions       : " << stats.positions << endl
+                 << "Solved          : " << stats.solved << endl
+                 << "Matched         : " << stats.matched << endl
+                 << "Cooked          : " << stats.cooked << endl
+                 << "Failed          : " << stats.failed << endl
+                 << "Nodes           : " << stats.nodes << endl
+                 << "Time (ms)       : " << stats.timeMs << endl
+                 << "Nodes/second    : " << stats.nodes * 1000 / (stats.timeMs ? stats.timeMs : 1) << endl;
+        }
+
+        // savehash <path>: snapshots the table of the computer to move, or else
+        // of the first computer, for "setoption hashfile" in a later session
+        void saveHash(istringstream& ss) {
+            string path;
+            ss >> path;
+            Computer* computer = nullptr;
+            for (int side : {isGameSetup ? chessBoard->getSide() : WHITE_SIDE, WHITE_SIDE, BLACK_SIDE}) {
+                if (!computer && side < static_cast<int>(players.size())) computer = dynamic_cast<Computer*>(players[side]);
+            }
+            if (!computer) throw runtime_error("No computer player to save the hash of");
+            if (!computer->saveHash(path)) throw runtime_error("Could not write hash snapshot " + path);
+            cout << "Saved hash snapshot to " << path << endl;
+        }
+
+        // serve <port|socket path> [workers]: hosts concurrent games until killed
+        void serve(istringstream& ss) {
+            string address;
+            int workers = max(1u, thread::hardware_concurrency());
+            ss >> address >> workers;
+            GameServer server{searchOptions, searchLimits, workers};
+            server.listen(address);
+            cout << "Serving on " << address << " with " << workers << " workers" << endl;
+            server.run();
+        }
+
         void start() {
             string inputs;
             while (getline(cin, inputs)) {
@@ -75,7 +400,29 @@ class Controller{
                     istringstream ss{inputs};
                     string command;
                     ss >> command;
-                    if (isGameSetup) {
+                    if (command == "setoption") {
+                        handleOption(ss);
+                    } else if (command == "bench") {
+                        bench(ss);
+                    } else if (command == "perft") {
+                        perft(ss);
+                    } else if (command == "bitbase") {
+                        generateBitbases(ss);
+                    } else if (command == "archive") {
+                        convertArchive(ss);
+                    } else if (command == "memory") {
+                        printMemoryReport(cout);
+                    } else if (command == "savehash") {
+                        saveHash(ss);
+                    } else if (command == "explorer") {
+                        explore(ss);
+                    } else if (command == "mate") {
+                        solveMate(ss);
+                    } else if (command == "pgn") {
+                        replayPgn(ss);
+                    } else if (command == "serve") {
+                        serve(ss);
+                    } else if (isGameSetup) {
                         handleRunningGame(command, ss);
                     } else {
                         handleSetup(command, ss);
@@ -87,11 +434,32 @@ class Controller{
     }
 };
 
-int main() {
+int main(int argc, char* argv[]) {
 #ifdef DEBUG
     cout << "(DEBUG MODE)" << endl;
 #endif
     Controller game{};
+    string mode = argc > 1 ? argv[1] : "";
+    if (mode == "bench" || mode == "perft" || mode == "bitbase" || mode == "serve" || mode == "pgn" || mode == "archive" ||
+        mode == "explorer" || mode == "mate") {
+        string args;
+        for (int i = 2; i < argc; ++i) args += string(argv[i]) + " ";
+        istringstream ss{args};
+        try {
+            if (mode == "bench") game.bench(ss);
+            else if (mode == "perft") game.perft(ss);
+            else if (mode == "serve") game.serve(ss);
+            else if (mode == "pgn") game.replayPgn(ss);
+            else if (mode == "archive") game.convertArchive(ss);
+            else if (mode == "explorer") game.explore(ss);
+            else if (mode == "mate") game.solveMate(ss);
+            else game.generateBitbases(ss);
+        } catch(runtime_error& e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
     game.start();
     return 0;
 }
\ No newline at end of file
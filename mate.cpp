@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include "mate.hpp"
+#include "util.hpp"
+
+using namespace std;
+
+// keeps the bounds of one attacker apart from the other's in a shared table
+#define BLACK_ATTACKER_SALT 0x9E3779B97F4A7C15ULL
+
+MateOptions::MateOptions(): maxMoves{5}, checksOnly{true}, maxNodes{0}, tableMb{16} {}
+
+MateSolver::MateSolver(const MateOptions& options):
+    options{options}, table{}, mask{0}, salt{0}, nodes{0}, aborted{false} {
+    size_t entries = 1;
+    while (entries * 2 * sizeof(Entry) <= static_cast<size_t>(max(options.tableMb, 1)) * 1024 * 1024) entries *= 2;
+    table.assign(entries, Entry{0, 0, 0, NO_MOVE});
+    mask = entries - 1;
+}
+
+// false, with the board unchanged, for an illegal move
+bool MateSolver::makeCounted(Board& board, EncMove move) {
+    if (++nodes > options.maxNodes && options.maxNodes) aborted = true;
+    return board.makeMove(move) != ILLEGAL_MOVE;
+}
+
+// every pseudo-legal move, or only checks when asked or on the last move
+vector<EncMove> MateSolver::attackerMoves(Board& board, int moves) {
+    vector<EncMove> list = board.generatePseudoMoves(board.getSide());
+    if (options.checksOnly || moves == 1) {
+        CheckInfo info = board.getCheckInfo();
+        list.erase(remove_if(list.begin(), list.end(), [&](EncMove move) { return !board.givesCheck(move, info); }),
+                   list.end());
+    }
+    return list;
+}
+
+int MateSolver::countReplies(Board& board, bool stopAtOne) {
+    vector<EncMove> replies;
+    board.generateEvasions(board.getSide(), replies);
+    int count = 0;
+    for (EncMove reply : replies) {
+        if (board.makeMove(reply) == ILLEGAL_MOVE) continue;
+        board.undoMove();
+        if (++count == 1 && stopAtOne) break;
+    }
+    return count;
+}
+
+// the side to move mates within the given number of its moves
+bool MateSolver::attack(Board& board, int moves) {
+    BitBoard key = board.getHashKey() ^ salt;
+    Entry& entry = table[key & mask];
+    if (entry.key == key) {
+        if (entry.proven && entry.proven <= moves) return true;
+        if (entry.disproven >= moves) return false;
+    }
+
+    int defender = board.getSide() ^ 1;
+    vector<pair<int, EncMove>> ordered;
+    EncMove mate = NO_MOVE;
+    for (EncMove move : attackerMoves(board, moves)) {
+        if (aborted) return false;
+        if (!makeCounted(board, move)) continue;
+        int replies = countReplies(board, moves == 1);
+        bool mates = replies == 0 && board.isKingInCheck(defender);
+        board.undoMove();
+        if (mates) {
+            mate = move;
+            break;
+        }
+        // a stalemate is no way forward
+        if (replies > 0 && moves > 1) ordered.push_back({replies, move});
+    }
+
+    if (mate == NO_MOVE && !aborted) {
+        stable_sort(ordered.begin(), ordered.end(),
+                    [](const pair<int, EncMove>& a, const pair<int, EncMove>& b) { return a.first < b.first; });
+        for (const auto& candidate : ordered) {
+            makeCounted(board, candidate.second);
+            bool wins = defend(board, moves - 1);
+            board.undoMove();
+            if (aborted) return false;
+            if (wins) {
+                mate = candidate.second;
+                break;
+            }
+        }
+    }
+    if (aborted) return false;
+
+    if (entry.key != key) entry = Entry{key, 0, 0, NO_MOVE};
+    if (mate != NO_MOVE) {
+        if (!entry.proven || moves < entry.proven) {
+            entry.proven = static_cast<uint8_t>(moves);
+            entry.move = mate;
+        }
+        return true;
+    }
+    entry.disproven = static_cast<uint8_t>(max<int>(entry.disproven, moves));
+    return false;
+}
+
+// the side to move, having just been given a move by the attacker, is
+// mated now or within the attacker's remaining moves whatever it plays
+bool MateSolver::defend(Board& board, int moves) {
+    int side = board.getSide();
+    vector<EncMove> replies;
+    board.generateEvasions(side, replies);
+    bool anyLegal = false;
+    for (EncMove reply : replies) {
+        if (!makeCounted(board, reply)) continue;
+        anyLegal = true;
+        bool lost = moves > 0 && attack(board, moves);
+        board.undoMove();
+        if (aborted || !lost) return false;
+    }
+    return anyLegal || board.isKingInCheck(side);
+}
+
+MateResult MateSolver::solve(Board& board) {
+    uint64_t startTime = getCurrentTimeInMs();
+    MateResult result{0, NO_MOVE, 0, false, 0, 0};
+    nodes = 0;
+    aborted = false;
+    salt = board.getSide() == WHITE_SIDE ? 0 : BLACK_ATTACKER_SALT;
+
+    for (int moves = 1; moves <= options.maxMoves && !aborted; ++moves) {
+        if (!attack(board, moves)) continue;
+        result.mateIn = moves;
+        // the key move and any rival keys, to flag cooked puzzles
+        for (EncMove move : attackerMoves(board, moves)) {
+            if (!makeCounted(board, move)) continue;
+            bool mates = defend(board, moves - 1);
+            board.undoMove();
+            if (aborted) break;
+            if (!mates) continue;
+            if (result.keyMove == NO_MOVE) result.keyMove = move;
+            ++result.solutions;
+        }
+        break;
+    }
+    result.aborted = aborted;
+    result.nodes = nodes;
+    result.timeMs = getCurrentTimeInMs() - startTime;
+    return result;
+}
+
+static string trim(const string& text) {
+    size_t first = text.find_first_not_of(" \t\r\n"), last = text.find_last_not_of(" \t\r\n");
+    return first == string::npos ? "" : text.substr(first, last - first + 1);
+}
+
+vector<MatePuzzle> readEpd(const string& path) {
+    ifstream in{path};
+    if (!in) throw runtime_error("Could not open EPD: " + path);
+    vector<MatePuzzle> puzzles;
+    string line;
+    for (int number = 1; getline(in, line); ++number) {
+        if (trim(line).empty() || trim(line)[0] == '#') continue;
+        istringstream ss{line};
+        string fields[4];
+        if (!(ss >> fields[0] >> fields[1] >> fields[2] >> fields[3])) continue;
+        MatePuzzle puzzle{"line " + to_string(number), fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3] + " 0 1",
+                          0, ""};
+        string operations;
+        getline(ss, operations);
+        istringstream ops{operations};
+        string operation;
+        while (getline(ops, operation, ';')) {
+            istringstream op{trim(operation)};
+            string opcode, operand;
+            op >> opcode;
+            getline(op >> ws, operand);
+            operand.erase(remove(operand.begin(), operand.end(), '"'), operand.end());
+            if (opcode == "id") puzzle.id = operand;
+            else if (opcode == "dm") puzzle.mateIn = atoi(operand.c_str());
+            else if (opcode == "bm") puzzle.bestMove = operand.substr(0, operand.find(' '));
+        }
+        puzzles.push_back(puzzle);
+    }
+    return puzzles;
+}
+
+// SAN without check, mate or annotation marks, so "Qxf7#" matches "Qxf7"
+static string bareSan(string san) {
+    san.erase(remove_if(san.begin(), san.end(), [](char c) { return c == '+' || c == '#' || c == '!' || c == '?'; }),
+              san.end());
+    return san;
+}
+
+MateBatchStats solveEpd(const vector<MatePuzzle>& puzzles, int threads, const MateOptions& options, ostream& out) {
+    uint64_t startTime = getCurrentTimeInMs();
+    vector<MateResult> results(puzzles.size(), MateResult{0, NO_MOVE, 0, false, 0, 0});
+    vector<string> errors(puzzles.size());
+    atomic<size_t> next{0};
+    auto work = [&]() {
+        MateSolver solver{options};
+        for (size_t i = next++; i < puzzles.size(); i = next++) {
+            if (!Board::isValidFen(puzzles[i].fen)) {
+                errors[i] = "invalid FEN";
+                continue;
+            }
+            try {
+                Board board{puzzles[i].fen};
+                results[i] = solver.solve(board);
+            } catch (const exception& e) {
+                errors[i] = e.what();
+            }
+        }
+    };
+    vector<thread> workers;
+    for (int i = 1; i < threads; ++i) workers.emplace_back(work);
+    work();
+    for (auto& worker : workers) worker.join();
+
+    MateBatchStats stats{static_cast<int>(puzzles.size()), 0, 0, 0, 0, 0, 0};
+    for (size_t i = 0; i < puzzles.size(); ++i) {
+        const MatePuzzle& puzzle = puzzles[i];
+        const MateResult& result = results[i];
+        stats.nodes += result.nodes;
+        string key = "-", status;
+        if (result.mateIn) {
+            Board board{puzzle.fen};
+            key = board.toSan(result.keyMove);
+            ++stats.solved;
+            if (result.solutions > 1) ++stats.cooked;
+        }
+        if (!errors[i].empty()) status = "error: " + errors[i];
+        else if (!result.mateIn) status = result.aborted ? "node limit" : "no mate found";
+        else if (puzzle.mateIn && puzzle.mateIn != result.mateIn) status = "expected mate in " + to_string(puzzle.mateIn);
+        else if (!puzzle.bestMove.empty() && bareSan(puzzle.bestMove) != bareSan(key)) status = "expected " + puzzle.bestMove;
+        else status = result.solutions > 1 ? "ok, " + to_string(result.solutions) + " keys" : "ok";
+        if (status.compare(0, 2, "ok") == 0) ++stats.matched;
+        else ++stats.failed;
+
+        out << left << setw(20) << puzzle.id << right
+            << " mate " << setw(2) << (result.mateIn ? to_string(result.mateIn) : "-")
+            << "  " << left << setw(8) << key << right
+            << setw(12) << result.nodes << " nodes " << setw(6) << result.timeMs << " ms  " << status << endl;
+    }
+    stats.timeMs = getCurrentTimeInMs() - startTime;
+    return stats;
+}
@@ -0,0 +1,77 @@
+#ifndef __MATE_H__
+#define __MATE_H__
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "board.hpp"
+
+struct MateOptions {
+    int maxMoves;      // longest mate looked for, in moves of the attacker
+    bool checksOnly;   // the attacker only gives check; far faster, misses quiet keys
+    uint64_t maxNodes; // per position, 0 for no limit
+    int tableMb;       // node table of each solver
+    MateOptions();
+};
+
+struct MateResult {
+    int mateIn;        // 0 when no mate was found
+    EncMove keyMove;
+    int solutions;     // first moves mating as fast, more than one is a cook
+    bool aborted;      // ran out of nodes before a proof
+    uint64_t nodes, timeMs;
+};
+
+// Proves "mate in n" for the side to move with a boolean AND/OR search:
+// the attacker needs one move after which every defence loses within n
+// moves, the defender one reply that holds. Defences to a check come from
+// Board::generateEvasions, the attacker's most forcing moves (fewest
+// replies) are tried first and each side stops at its first success.
+// Iterative deepening over n finds the shortest mate. Proven and disproven
+// bounds of attacker nodes are kept in the solver's own table, so neither
+// the search's transposition table nor its evaluation is involved.
+class MateSolver {
+    struct Entry {
+        BitBoard key;
+        uint8_t proven;    // mate known within this many moves, 0 if none
+        uint8_t disproven; // no mate within this many moves
+        EncMove move;
+    };
+    MateOptions options;
+    std::vector<Entry> table;
+    BitBoard mask, salt;
+    uint64_t nodes;
+    bool aborted;
+
+    bool makeCounted(Board& board, EncMove move);
+    std::vector<EncMove> attackerMoves(Board& board, int moves);
+    int countReplies(Board& board, bool stopAtOne);
+    bool attack(Board& board, int moves);
+    bool defend(Board& board, int moves);
+    public:
+        MateSolver(const MateOptions& options = MateOptions());
+        MateResult solve(Board& board);
+};
+
+struct MatePuzzle {
+    std::string id, fen;
+    int mateIn;         // the EPD "dm" operation, 0 when absent
+    std::string bestMove; // the EPD "bm" operation in SAN, empty when absent
+};
+
+struct MateBatchStats {
+    int positions, solved, matched, cooked, failed;
+    uint64_t nodes, timeMs;
+};
+
+// one puzzle per line: four FEN fields, then operations such as
+// bm Qxf7#; dm 2; id "puzzle 1";
+std::vector<MatePuzzle> readEpd(const std::string& path);
+
+// Solves every puzzle of an EPD file on several threads, each with its own
+// solver, and prints one line per puzzle in file order plus a summary.
+// A puzzle fails when no mate is found or it disagrees with its dm or bm.
+MateBatchStats solveEpd(const std::vector<MatePuzzle>& puzzles, int threads, const MateOptions& options,
+                        std::ostream& out);
+
+#endif
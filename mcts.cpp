@@ -0,0 +1,427 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include "mcts.hpp"
+#include "memory.hpp"
+#include "move.hpp"
+
+using namespace std;
+
+#define NODE_LEAF 0
+#define NODE_EXPANDING 1
+#define NODE_EXPANDED 2
+#define MCTS_FIRST_CHECKPOINT 1024
+#define MCTS_CHECK_PLAYOUTS 16 // of the main thread between limit checks
+
+// indexed by getPieceIndex(piece) % 6
+const static int pieceValue[6] = {100, 320, 330, 500, 900, 20000};
+
+// logistic mapping between centipawns and the expected result
+static double winRate(int score) {
+    return 1.0 / (1.0 + pow(10.0, -score / 400.0));
+}
+
+static int scoreFromWinRate(double rate) {
+    rate = min(max(rate, 0.001), 0.999);
+    return static_cast<int>(lround(-400.0 * log10(1.0 / rate - 1.0)));
+}
+
+MctsSearch::MctsSearch(const SearchOptions& options):
+    options{options}, workers{}, arena{nullptr}, capacity{0}, used{0}, root{0}, rootBoard{}, hasTree{false},
+    stopped{false}, playouts{0}, limits{}, timeManager{}, nextCheckpoint{MCTS_FIRST_CHECKPOINT} {
+    allocateArena();
+}
+
+MctsSearch::~MctsSearch() {
+    freeLarge(arena);
+}
+
+void MctsSearch::allocateArena() {
+    freeLarge(arena);
+    size_t bytes = static_cast<size_t>(max(options.mcts.arenaMb, 1)) * 1024 * 1024;
+    capacity = min<size_t>(bytes / sizeof(Node), UINT32_MAX);
+    arena = static_cast<Node*>(allocateLarge(capacity * sizeof(Node)));
+    used = 0;
+    hasTree = false;
+}
+
+void MctsSearch::setOptions(const SearchOptions& newOptions) {
+    bool resize = newOptions.mcts.arenaMb != options.mcts.arenaMb;
+    options = newOptions;
+    if (resize) allocateArena();
+}
+
+void MctsSearch::stop() {
+    stopped = true;
+}
+
+void MctsSearch::clear() {
+    hasTree = false;
+}
+
+static void initNode(atomic<uint32_t>& visits, atomic<uint64_t>& value, atomic<uint8_t>& state) {
+    visits.store(0, memory_order_relaxed);
+    value.store(0, memory_order_relaxed);
+    state.store(NODE_LEAF, memory_order_relaxed);
+}
+
+void MctsSearch::resetTree(const Board& board) {
+    Node& node = arena[0];
+    initNode(node.visits, node.value, node.state);
+    node.terminal = 0;
+    node.childCount = 0;
+    node.firstChild = 0;
+    node.move = NO_MOVE;
+    node.prior = 1;
+    node.terminalValue = 0;
+    used = 1;
+    root = 0;
+    rootBoard = board;
+    hasTree = true;
+}
+
+// the new root is the old one, a child after pondering-style reuse, or a
+// grandchild after our move and the reply; its statistics stay valid
+bool MctsSearch::reuseTree(const Board& board) {
+    if (!hasTree || !options.mcts.reuseTree || used >= capacity / 4 * 3) return false;
+    BitBoard key = board.getHashKey();
+    if (rootBoard.getHashKey() == key) {
+        rootBoard = board;
+        return true;
+    }
+    const Node& current = arena[root];
+    if (current.state.load(memory_order_acquire) != NODE_EXPANDED) return false;
+    Board probe = rootBoard;
+    for (uint32_t c = current.firstChild; c < current.firstChild + current.childCount; ++c) {
+        probe.makeMove(arena[c].move);
+        bool found = probe.getHashKey() == key;
+        if (!found && arena[c].state.load(memory_order_acquire) == NODE_EXPANDED) {
+            for (uint32_t g = arena[c].firstChild; g < arena[c].firstChild + arena[c].childCount && !found; ++g) {
+                probe.makeMove(arena[g].move);
+                if (probe.getHashKey() == key) {
+                    root = g;
+                    found = true;
+                }
+                probe.undoMove();
+            }
+        } else if (found) {
+            root = c;
+        }
+        probe.undoMove();
+        if (found) {
+            rootBoard = board;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Claims an unexpanded node and creates its children; false if another
+// thread holds it or the arena is full, in which case it stays a leaf.
+bool MctsSearch::expand(uint32_t index, Worker& worker) {
+    Node& node = arena[index];
+    uint8_t expected = NODE_LEAF;
+    if (!node.state.compare_exchange_strong(expected, NODE_EXPANDING, memory_order_acquire)) return false;
+
+    Board& board = worker.board;
+    int side = board.getSide();
+    vector<EncMove> moves;
+    // the game goes on at the root whatever the rules would let the opponent claim
+    if (index != root && (board.getFifty() >= 100 || board.isRepetition() || board.isInsufficientMaterial())) {
+        node.terminal = 1;
+        node.terminalValue = 0.5;
+    } else {
+        moves = board.generateLegalMoves(side);
+        if (moves.empty()) {
+            // results are for the side that moved into the node
+            node.terminal = 1;
+            node.terminalValue = board.isKingInCheck(side) ? 1.0 : 0.5;
+        }
+    }
+    if (node.terminal) {
+        node.state.store(NODE_EXPANDED, memory_order_release);
+        return true;
+    }
+
+    size_t first = used.fetch_add(moves.size(), memory_order_relaxed);
+    if (first + moves.size() > capacity) {
+        node.state.store(NODE_LEAF, memory_order_release);
+        return false;
+    }
+
+    // PUCT priors: a softmax over cheap move features, captures by MVV-LVA
+    vector<double> priors(moves.size(), 1.0 / moves.size());
+    if (options.mcts.puct) {
+        CheckInfo info = board.getCheckInfo();
+        double total = 0;
+        for (size_t i = 0; i < moves.size(); ++i) {
+            Move move{moves[i]};
+            double logit = 0;
+            if (move.isCapture()) {
+                int attacker = getPieceIndex(board.getSquare(move.getSource())) % 6;
+                int victim = move.isEnpassant() ? 0 : getPieceIndex(board.getSquare(move.getTarget())) % 6;
+                logit += 1.0 + (pieceValue[victim] - pieceValue[attacker] / 10) / 300.0;
+            }
+            if (move.getMoveType() == QUEEN_PROMOTION || move.getMoveType() == QUEEN_PROMOTION_CAPTURE) logit += 2.0;
+            if (board.givesCheck(moves[i], info)) logit += 0.8;
+            priors[i] = exp(logit);
+            total += priors[i];
+        }
+        for (double& prior : priors) prior /= total;
+    }
+
+    for (size_t i = 0; i < moves.size(); ++i) {
+        Node& child = arena[first + i];
+        initNode(child.visits, child.value, child.state);
+        child.terminal = 0;
+        child.childCount = 0;
+        child.firstChild = 0;
+        child.move = moves[i];
+        child.prior = static_cast<float>(priors[i]);
+        child.terminalValue = 0;
+    }
+    node.firstChild = static_cast<uint32_t>(first);
+    node.childCount = static_cast<uint16_t>(moves.size());
+    node.state.store(NODE_EXPANDED, memory_order_release);
+    return true;
+}
+
+// UCT: Q + c * sqrt(ln N / n), every child tried once first, in prior order.
+// PUCT: Q + c * P * sqrt(N) / (1 + n), unvisited children valued a little
+// below their parent. Visits include the virtual losses of other threads.
+uint32_t MctsSearch::select(uint32_t index) const {
+    const Node& node = arena[index];
+    double parentVisits = max<uint32_t>(node.visits.load(memory_order_relaxed), 1);
+    double parentValue = node.value.load(memory_order_relaxed) / static_cast<double>(MCTS_VALUE_SCALE);
+    double firstPlay = max(0.0, 1.0 - parentValue / parentVisits - 0.1);
+    double c = options.mcts.exploration, logVisits = log(parentVisits), sqrtVisits = sqrt(parentVisits);
+
+    uint32_t best = node.firstChild;
+    double bestScore = -1e9;
+    for (uint32_t i = node.firstChild; i < node.firstChild + node.childCount; ++i) {
+        const Node& child = arena[i];
+        uint32_t visits = child.visits.load(memory_order_relaxed);
+        double score;
+        if (!options.mcts.puct) {
+            if (visits == 0) return i;
+            double q = child.value.load(memory_order_relaxed) / static_cast<double>(MCTS_VALUE_SCALE) / visits;
+            score = q + c * sqrt(logVisits / visits);
+        } else {
+            double q = visits ? child.value.load(memory_order_relaxed) / static_cast<double>(MCTS_VALUE_SCALE) / visits
+                              : firstPlay;
+            score = q + c * child.prior * sqrtVisits / (1 + visits);
+        }
+        if (score > bestScore) {
+            bestScore = score;
+            best = i;
+        }
+    }
+    return best;
+}
+
+// captures and queen promotions only, without checking for mates
+int MctsSearch::quiescence(Worker& worker, int alpha, int beta, int plies) {
+    Board& board = worker.board;
+    int standPat = worker.evaluator.evaluate(board);
+    if (plies == 0 || standPat >= beta) return standPat;
+    alpha = max(alpha, standPat);
+
+    vector<pair<int, EncMove>> captures;
+    for (EncMove encMove : board.generatePseudoMoves(board.getSide())) {
+        Move move{encMove};
+        if (!move.isCapture() && move.getMoveType() != QUEEN_PROMOTION) continue;
+        int victim = move.isCapture() && !move.isEnpassant() ? getPieceIndex(board.getSquare(move.getTarget())) % 6 : 0;
+        captures.push_back({-pieceValue[victim], encMove});
+    }
+    sort(captures.begin(), captures.end());
+
+    int bestScore = standPat;
+    for (const auto& capture : captures) {
+        if (board.makeMove(capture.second) == ILLEGAL_MOVE) continue;
+        int score = -quiescence(worker, -beta, -alpha, plies - 1);
+        board.undoMove();
+        if (score > bestScore) {
+            bestScore = score;
+            alpha = max(alpha, score);
+            if (score >= beta) break;
+        }
+    }
+    return bestScore;
+}
+
+// expected result for the side to move on the worker's board
+double MctsSearch::evaluate(Worker& worker) {
+    int plies = options.mcts.quiescence;
+    int score = plies > 0 ? quiescence(worker, -INF_SCORE, INF_SCORE, plies) : worker.evaluator.evaluate(worker.board);
+    return winRate(score);
+}
+
+void MctsSearch::playout(Worker& worker) {
+    Board& board = worker.board;
+    uint32_t path[MAX_PLY];
+    int length = 0;
+    uint32_t index = root;
+    path[length++] = index;
+    arena[index].visits.fetch_add(MCTS_VIRTUAL_LOSS, memory_order_relaxed);
+
+    double result;
+    while (true) {
+        Node& node = arena[index];
+        uint8_t state = node.state.load(memory_order_acquire);
+        bool fresh = state == NODE_LEAF && expand(index, worker);
+        if ((fresh || state == NODE_EXPANDED) && node.terminal) {
+            result = node.terminalValue;
+            break;
+        }
+        // a new leaf, one another thread is expanding, or the arena is full
+        if (fresh || state != NODE_EXPANDED || length == MAX_PLY) {
+            result = 1.0 - evaluate(worker);
+            break;
+        }
+        index = select(index);
+        board.makeMove(arena[index].move);
+        arena[index].visits.fetch_add(MCTS_VIRTUAL_LOSS, memory_order_relaxed);
+        path[length++] = index;
+    }
+
+    for (int i = length - 1; i >= 0; --i) {
+        Node& node = arena[path[i]];
+        node.value.fetch_add(static_cast<uint64_t>(llround(result * MCTS_VALUE_SCALE)), memory_order_relaxed);
+        node.visits.fetch_sub(MCTS_VIRTUAL_LOSS - 1, memory_order_relaxed);
+        result = 1.0 - result;
+    }
+    for (int i = 1; i < length; ++i) board.undoMove();
+    playouts.fetch_add(1, memory_order_relaxed);
+}
+
+// only the main thread manages time: its checks land on doubling playout
+// counts, which stand in for the iterations the time manager expects
+bool MctsSearch::shouldStop(uint64_t done) {
+    if (limits.nodes && done >= limits.nodes) return true;
+    if (timeManager.hardLimitReached()) return true;
+    if (!limits.nodes && !limits.movetime && !limits.time && used >= capacity) return true;
+    if (done < nextCheckpoint) return false;
+    nextCheckpoint *= 2;
+    MctsReport report = makeReport(0);
+    if (options.showInfo) printInfo(report);
+    return timeManager.shouldStopIteration(report.bestMove, scoreFromWinRate(report.winRate));
+}
+
+void MctsSearch::work(int id) {
+    if (options.pinThreads) pinCurrentThread(id);
+    Worker& worker = *workers[id];
+    for (uint64_t own = 1; !stopped.load(memory_order_relaxed); ++own) {
+        playout(worker);
+        if (id == 0 && own % MCTS_CHECK_PLAYOUTS == 0 && shouldStop(playouts.load(memory_order_relaxed))) stopped = true;
+    }
+}
+
+MctsReport MctsSearch::makeReport(uint64_t startTime) const {
+    MctsReport report{NO_MOVE, {}, 0.5, playouts.load(memory_order_relaxed), min<size_t>(used, capacity), 0};
+    report.timeMs = startTime ? getCurrentTimeInMs() - startTime : timeManager.elapsed();
+    uint32_t index = root;
+    while (arena[index].state.load(memory_order_acquire) == NODE_EXPANDED && arena[index].childCount > 0) {
+        const Node& node = arena[index];
+        uint32_t best = node.firstChild;
+        for (uint32_t i = node.firstChild; i < node.firstChild + node.childCount; ++i) {
+            if (arena[i].visits.load(memory_order_relaxed) > arena[best].visits.load(memory_order_relaxed)) best = i;
+        }
+        uint32_t visits = arena[best].visits.load(memory_order_relaxed);
+        if (visits == 0) break;
+        if (index == root) {
+            report.bestMove = arena[best].move;
+            report.winRate = arena[best].value.load(memory_order_relaxed) / static_cast<double>(MCTS_VALUE_SCALE) / visits;
+        }
+        report.pv.push_back(arena[best].move);
+        index = best;
+    }
+    return report;
+}
+
+void MctsSearch::printInfo(const MctsReport& report) const {
+    cout << "info playouts " << report.playouts
+         << " nodes " << report.nodes
+         << " pps " << report.playouts * 1000 / (report.timeMs ? report.timeMs : 1)
+         << " time " << report.timeMs
+         << " score cp " << scoreFromWinRate(report.winRate)
+         << " winrate " << static_cast<int>(report.winRate * 1000) / 10.0
+         << " pv";
+    for (EncMove move : report.pv) cout << " " << Move{move}.toString();
+    cout << endl;
+}
+
+MctsReport MctsSearch::run(const Board& board, const SearchLimits& searchLimits) {
+    uint64_t startTime = getCurrentTimeInMs();
+    limits = searchLimits;
+    stopped = false;
+    playouts = 0;
+    nextCheckpoint = MCTS_FIRST_CHECKPOINT;
+
+    int threads = max(options.threads, 1);
+    while (static_cast<int>(workers.size()) < threads) workers.emplace_back(new Worker);
+    workers.resize(threads);
+
+    if (!reuseTree(board) || arena[root].terminal) resetTree(board);
+    for (auto& worker : workers) worker->board = rootBoard;
+    if (arena[root].state.load(memory_order_acquire) == NODE_LEAF && !expand(root, *workers[0])) {
+        resetTree(board);
+        expand(root, *workers[0]);
+    }
+    if (arena[root].terminal || arena[root].childCount == 0) return makeReport(startTime);
+    timeManager.start(limits, startTime, arena[root].childCount);
+
+    vector<thread> helpers;
+    for (int i = 1; i < threads; ++i) helpers.emplace_back(&MctsSearch::work, this, i);
+    work(0);
+    for (auto& helper : helpers) helper.join();
+
+    MctsReport report = makeReport(startTime);
+    if (options.showInfo) printInfo(report);
+    return report;
+}
+
+MctsPlayer::MctsPlayer(int side, const SearchOptions& options, const SearchLimits& limits):
+    Player{side}, search{options}, limits{limits}, clock{limits.time}, movesToGo{limits.movesToGo} {}
+
+void MctsPlayer::configure(const SearchOptions& options, const SearchLimits& newLimits) {
+    search.setOptions(options);
+    if (newLimits.time != limits.time || newLimits.movesToGo != limits.movesToGo) {
+        clock = newLimits.time;
+        movesToGo = newLimits.movesToGo;
+    }
+    limits = newLimits;
+}
+
+// takes the same per-move limits as the computer player; "nodes" counts playouts
+int MctsPlayer::move(Board* chessBoard, istringstream &ss) {
+    uint64_t startTime = getCurrentTimeInMs();
+    SearchLimits moveLimits = limits;
+    moveLimits.time = clock;
+    moveLimits.movesToGo = movesToGo;
+    bool white = side == WHITE_SIDE;
+    string name;
+    uint64_t value;
+    while (ss >> name >> value) {
+        if (name == "movetime") moveLimits.movetime = value;
+        else if (name == "nodes") moveLimits.nodes = value;
+        else if (name == (white ? "wtime" : "btime")) clock = moveLimits.time = value;
+        else if (name == (white ? "winc" : "binc")) moveLimits.increment = value;
+        else if (name == "movestogo") movesToGo = moveLimits.movesToGo = static_cast<int>(value);
+    }
+
+    MctsReport report = search.run(*chessBoard, moveLimits);
+    if (report.bestMove == NO_MOVE) throw runtime_error("No legal move to play!");
+
+    if (clock) {
+        uint64_t elapsed = getCurrentTimeInMs() - startTime;
+        clock = (clock > elapsed ? clock - elapsed : 0) + moveLimits.increment;
+        if (movesToGo && --movesToGo == 0) {
+            clock += limits.time;
+            movesToGo = limits.movesToGo;
+        }
+    }
+    cout << "bestmove " << Move{report.bestMove}.toString() << endl;
+    return chessBoard->makeMove(report.bestMove);
+}
@@ -0,0 +1,98 @@
+#ifndef __MCTS_H__
+#define __MCTS_H__
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "board.hpp"
+#include "eval.hpp"
+#include "player.hpp"
+#include "search.hpp"
+
+#define MCTS_VIRTUAL_LOSS 3
+#define MCTS_VALUE_SCALE 65536 // fixed point of the summed results
+
+struct MctsReport {
+    EncMove bestMove;
+    std::vector<EncMove> pv; // most visited line
+    double winRate;          // of the side to move at the root
+    uint64_t playouts, nodes, timeMs;
+};
+
+// Monte Carlo tree search over Board. Threads descend the shared tree at
+// once, each adding a virtual loss to the nodes on its path so the others
+// spread out, expand the leaf they reach and back up the result of a
+// static evaluation or a short capture search, mapped to a win rate.
+//
+// Nodes live in one arena handed out by an atomic bump pointer; a node's
+// children are contiguous, so a node only stores the index of the first.
+// The tree under the position two plies on is kept for the next move, and
+// the arena is only reset when the reused tree has filled most of it.
+class MctsSearch {
+    struct Node {
+        std::atomic<uint32_t> visits; // real visits plus virtual losses in flight
+        std::atomic<uint64_t> value;  // summed results for the side that moved into the node
+        std::atomic<uint8_t> state;   // NODE_* in mcts.cpp
+        uint8_t terminal;             // 1 when the game is over at the node
+        uint16_t childCount;
+        uint32_t firstChild;
+        EncMove move;
+        float prior;
+        float terminalValue;
+    };
+    struct Worker {
+        Board board;
+        Evaluator evaluator;
+    };
+
+    SearchOptions options;
+    std::vector<std::unique_ptr<Worker>> workers;
+    Node* arena;
+    size_t capacity;
+    std::atomic<size_t> used;
+    uint32_t root;
+    Board rootBoard;
+    bool hasTree;
+    std::atomic<bool> stopped;
+    std::atomic<uint64_t> playouts;
+    SearchLimits limits;
+    TimeManager timeManager;
+    uint64_t nextCheckpoint; // playouts at which time is next managed, doubling like iterations
+
+    void allocateArena();
+    void resetTree(const Board& board);
+    bool reuseTree(const Board& board);
+    bool expand(uint32_t index, Worker& worker);
+    uint32_t select(uint32_t index) const;
+    double evaluate(Worker& worker);
+    int quiescence(Worker& worker, int alpha, int beta, int plies);
+    void playout(Worker& worker);
+    void work(int id);
+    bool shouldStop(uint64_t done);
+    MctsReport makeReport(uint64_t startTime) const;
+    void printInfo(const MctsReport& report) const;
+    public:
+        MctsSearch(const SearchOptions& options = SearchOptions());
+        ~MctsSearch();
+        MctsSearch(const MctsSearch&) = delete;
+        MctsSearch& operator=(const MctsSearch&) = delete;
+
+        void setOptions(const SearchOptions& options);
+        // limits.nodes counts playouts; depth is ignored
+        MctsReport run(const Board& board, const SearchLimits& limits);
+        void stop();
+        void clear();
+};
+
+class MctsPlayer : public Player {
+    MctsSearch search;
+    SearchLimits limits;
+    uint64_t clock;
+    int movesToGo;
+public:
+    MctsPlayer(int side, const SearchOptions& options, const SearchLimits& limits);
+    void configure(const SearchOptions& options, const SearchLimits& limits);
+    virtual int move(Board* chessBoard, std::istringstream &ss) override;
+};
+
+#endif
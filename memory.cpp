@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "memory.hpp"
+
+using namespace std;
+
+// from <linux/mempolicy.h>, which not every libc ships
+#define MPOL_INTERLEAVE_MODE 3
+#define MPOL_LOCAL_MODE 4
+
+enum PageKind {
+    PAGES_EXPLICIT,
+    PAGES_TRANSPARENT,
+    PAGES_REGULAR,
+};
+
+namespace {
+    struct Allocation {
+        size_t size;
+        PageKind kind;
+    };
+    struct Registry {
+        mutex lock;
+        map<const void*, Allocation> allocations;
+    };
+    // never destroyed, so tables freed by static destructors still find their entry
+    Registry& registry() {
+        static Registry* instance = new Registry;
+        return *instance;
+    }
+}
+
+static size_t roundToHugePages(size_t bytes) {
+    return (max<size_t>(bytes, 1) + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+static string readLine(const string& path) {
+    ifstream in{path};
+    string line;
+    getline(in, line);
+    return line;
+}
+
+// online nodes from a list such as "0", "0-1" or "0,2-3"
+static vector<int> onlineNodes() {
+    vector<int> nodes;
+    istringstream ss{readLine("/sys/devices/system/node/online")};
+    string range;
+    while (getline(ss, range, ',')) {
+        int first = 0, last = 0;
+        char dash = 0;
+        istringstream rs{range};
+        if (!(rs >> first)) continue;
+        last = rs >> dash >> last && dash == '-' ? last : first;
+        for (int node = first; node <= last; ++node) nodes.push_back(node);
+    }
+    if (nodes.empty()) nodes.push_back(0);
+    return nodes;
+}
+
+int numaNodeCount() {
+    static const int count = static_cast<int>(onlineNodes().size());
+    return count;
+}
+
+// must run before the pages are first touched; a kernel without NUMA
+// support or a sandbox refusing mbind leaves the default policy
+static void applyNumaPolicy(void* memory, size_t size, NumaPolicy numa) {
+    if (numa == NUMA_DEFAULT || numaNodeCount() < 2) return;
+    if (numa == NUMA_LOCAL) {
+        syscall(SYS_mbind, memory, size, MPOL_LOCAL_MODE, nullptr, 0, 0);
+        return;
+    }
+    vector<unsigned long> mask(1);
+    const int bits = 8 * sizeof(unsigned long);
+    for (int node : onlineNodes()) {
+        if (node / bits >= static_cast<int>(mask.size())) mask.resize(node / bits + 1);
+        mask[node / bits] |= 1UL << (node % bits);
+    }
+    syscall(SYS_mbind, memory, size, MPOL_INTERLEAVE_MODE, mask.data(), mask.size() * bits + 1, 0);
+}
+
+void* allocateLarge(size_t bytes, NumaPolicy numa) {
+    size_t size = roundToHugePages(bytes);
+    PageKind kind = PAGES_EXPLICIT;
+    void* memory = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (memory == MAP_FAILED) {
+        // over-map by a huge page and trim, so the region starts on a 2 MB boundary
+        void* raw = mmap(nullptr, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) throw bad_alloc();
+        char* start = static_cast<char*>(raw);
+        char* aligned = reinterpret_cast<char*>(
+            (reinterpret_cast<uintptr_t>(start) + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE);
+        if (aligned > start) munmap(start, aligned - start);
+        if (start + HUGE_PAGE_SIZE > aligned) munmap(aligned + size, start + HUGE_PAGE_SIZE - aligned);
+        memory = aligned;
+        kind = PAGES_REGULAR;
+#ifdef MADV_HUGEPAGE
+        if (madvise(memory, size, MADV_HUGEPAGE) == 0) kind = PAGES_TRANSPARENT;
+#endif
+    }
+    applyNumaPolicy(memory, size, numa);
+
+    lock_guard<mutex> lock{registry().lock};
+    registry().allocations[memory] = Allocation{size, kind};
+    return memory;
+}
+
+void freeLarge(void* memory) {
+    if (!memory) return;
+    size_t size;
+    {
+        lock_guard<mutex> lock{registry().lock};
+        auto found = registry().allocations.find(memory);
+        if (found == registry().allocations.end()) return;
+        size = found->second.size;
+        registry().allocations.erase(found);
+    }
+    munmap(memory, size);
+}
+
+bool isHugePageBacked(const void* memory) {
+    lock_guard<mutex> lock{registry().lock};
+    auto found = registry().allocations.find(memory);
+    return found != registry().allocations.end() && found->second.kind != PAGES_REGULAR;
+}
+
+bool pinCurrentThread(int index) {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return false;
+    int count = CPU_COUNT(&allowed);
+    if (count == 0) return false;
+    int target = index % count;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, &allowed) || target-- > 0) continue;
+        cpu_set_t pinned;
+        CPU_ZERO(&pinned);
+        CPU_SET(cpu, &pinned);
+        return pthread_setaffinity_np(pthread_self(), sizeof(pinned), &pinned) == 0;
+    }
+    return false;
+}
+
+void printMemoryReport(ostream& out) {
+    string pool = "/sys/kernel/mm/hugepages/hugepages-2048kB/";
+    string total = readLine(pool + "nr_hugepages"), free = readLine(pool + "free_hugepages");
+    string transparent = readLine("/sys/kernel/mm/transparent_hugepage/enabled");
+    size_t bytes[3] = {0, 0, 0};
+    {
+        lock_guard<mutex> lock{registry().lock};
+        for (const auto& allocation : registry().allocations) bytes[allocation.second.kind] += allocation.second.size;
+    }
+    out << "Huge page pool  : " << (total.empty() ? "unavailable" : free + " free of " + total + " 2 MB pages") << endl
+        << "Transparent     : " << (transparent.empty() ? "unavailable" : transparent) << endl
+        << "NUMA nodes      : " << numaNodeCount() << endl
+        << "Tables (MB)     : " << bytes[PAGES_EXPLICIT] / (1024 * 1024) << " explicit huge, "
+        << bytes[PAGES_TRANSPARENT] / (1024 * 1024) << " transparent huge, "
+        << bytes[PAGES_REGULAR] / (1024 * 1024) << " regular" << endl;
+}
@@ -0,0 +1,36 @@
+#ifndef __MEMORY_H__
+#define __MEMORY_H__
+
+#include <cstddef>
+#include <ostream>
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// Where the pages of a large allocation live on a NUMA machine: wherever
+// the kernel's default policy puts them (the node of the first thread to
+// touch each page), spread round-robin over every node, or always on the
+// node of the touching thread. Has no effect on a single node.
+enum NumaPolicy {
+    NUMA_DEFAULT,
+    NUMA_INTERLEAVE,
+    NUMA_LOCAL,
+};
+
+// Large, zeroed tables in their own mapping, rounded up to whole 2 MB huge
+// pages so a table costs a few TLB entries instead of one per 4 kB page.
+// Tries the kernel's huge page pool (MAP_HUGETLB), then transparent huge
+// pages on a 2 MB aligned region, and settles for plain pages when neither
+// is available. Throws std::bad_alloc when out of memory.
+void* allocateLarge(size_t bytes, NumaPolicy numa = NUMA_DEFAULT);
+void freeLarge(void* memory);
+bool isHugePageBacked(const void* memory); // from the pool, or advised transparent huge pages
+
+int numaNodeCount();
+// binds the calling thread to the index-th CPU the process may run on,
+// wrapping around; false if the kernel refused
+bool pinCurrentThread(int index);
+
+// huge page pool, transparent huge page mode, NUMA nodes and live tables
+void printMemoryReport(std::ostream& out);
+
+#endif
@@ -42,6 +42,12 @@ bool Move::isEnpassant() const {
     return getMoveType() == EN_PASSANT;
 }
 
+string Move::toString() const {
+    string str = positions[getSource()] + positions[getTarget()];
+    if (isPromotion()) str += "nbrq"[(getMoveType() - KNIGHT_PROMOTION) % 4];
+    return str;
+}
+
 std::ostream& operator<<(std::ostream& out, const Move& move) {
     int source = move.getSource();
     int target = move.getTarget();
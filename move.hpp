@@ -20,6 +20,7 @@ struct Move {
     bool isCapture() const;
     bool isCastle() const;
     bool isEnpassant() const;
+    std::string toString() const; // coordinate notation, e.g. e7e8q
     friend std::ostream& operator<<(std::ostream& out, const Move& move);
 };
 
@@ -0,0 +1,93 @@
+#include <memory>
+#include <thread>
+#include "perft.hpp"
+
+using namespace std;
+
+// data word layout: nodes (56) | depth (8)
+PerftTable::PerftTable(int sizeInMb): table{}, mask{0} {
+    size_t slots = 1;
+    while (slots * 2 * sizeof(Slot) <= static_cast<size_t>(sizeInMb) * 1024 * 1024) slots *= 2;
+    vector<Slot> resized(slots);
+    table.swap(resized);
+    mask = slots - 1;
+    for (auto& slot : table) {
+        slot.check.store(0, memory_order_relaxed);
+        slot.data.store(0, memory_order_relaxed);
+    }
+}
+
+// each depth of one position lands in a different slot
+static uint64_t slotIndex(BitBoard key, int depth) {
+    return key ^ (static_cast<uint64_t>(depth) * 0x9E3779B97F4A7C15ULL);
+}
+
+bool PerftTable::probe(BitBoard key, int depth, uint64_t& nodes) const {
+    const Slot& slot = table[slotIndex(key, depth) & mask];
+    uint64_t data = slot.data.load(memory_order_relaxed);
+    uint64_t check = slot.check.load(memory_order_relaxed);
+    if ((check ^ data) != key || static_cast<int>(data >> 56) != depth) return false;
+    nodes = data & ((1ULL << 56) - 1);
+    return true;
+}
+
+void PerftTable::store(BitBoard key, int depth, uint64_t nodes) {
+    Slot& slot = table[slotIndex(key, depth) & mask];
+    uint64_t data = nodes | static_cast<uint64_t>(depth) << 56;
+    slot.data.store(data, memory_order_relaxed);
+    slot.check.store(key ^ data, memory_order_relaxed);
+}
+
+uint64_t perft(Board& board, int depth, PerftTable* table) {
+    if (depth == 0) return 1;
+    // bulk counting: the leaves one ply down are just the legal moves here
+    if (depth == 1) return board.countLegalMoves();
+
+    uint64_t nodes = 0;
+    BitBoard key = board.getHashKey();
+    if (table && table->probe(key, depth, nodes)) return nodes;
+
+    for (EncMove move : board.generatePseudoMoves(board.getSide())) {
+        if (board.makeMove(move) == ILLEGAL_MOVE) continue;
+        nodes += perft(board, depth - 1, table);
+        board.undoMove();
+    }
+    if (table) table->store(key, depth, nodes);
+    return nodes;
+}
+
+PerftResult runPerft(const Board& board, int depth, int threads, int hashMb, ostream& out) {
+    uint64_t startTime = getCurrentTimeInMs();
+    Board root{board};
+    vector<EncMove> moves = root.generateLegalMoves(root.getSide());
+    vector<uint64_t> counts(moves.size(), 0);
+    unique_ptr<PerftTable> table{hashMb > 0 ? new PerftTable{hashMb} : nullptr};
+
+    atomic<size_t> next{0};
+    auto worker = [&]() {
+        Board local{board};
+        for (size_t i = next++; i < moves.size(); i = next++) {
+            local.makeMove(moves[i]);
+            counts[i] = depth > 1 ? perft(local, depth - 1, table.get()) : 1;
+            local.undoMove();
+        }
+    };
+    vector<thread> workers;
+    for (int i = 1; i < threads; ++i) workers.emplace_back(worker);
+    worker();
+    for (auto& t : workers) t.join();
+
+    PerftResult result = {0, 0};
+    for (size_t i = 0; i < moves.size(); ++i) {
+        out << Move{moves[i]}.toString() << ": " << counts[i] << endl;
+        result.nodes += counts[i];
+    }
+    if (depth == 0) result.nodes = 1;
+    result.timeMs = getCurrentTimeInMs() - startTime;
+
+    out << endl;
+    out << "Nodes searched  : " << result.nodes << endl;
+    out << "Total time (ms) : " << result.timeMs << endl;
+    out << "Nodes/second    : " << result.nodes * 1000 / (result.timeMs ? result.timeMs : 1) << endl;
+    return result;
+}
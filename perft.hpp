@@ -0,0 +1,35 @@
+#ifndef __PERFT_H__
+#define __PERFT_H__
+
+#include <atomic>
+#include <ostream>
+#include <vector>
+#include "board.hpp"
+
+// Leaf counts of transposed subtrees, keyed by Zobrist key and depth. Shared
+// by the perft threads the same way the search shares its TT: each slot
+// keeps the key xor'ed with its data word.
+class PerftTable {
+    struct Slot {
+        std::atomic<uint64_t> check, data;
+    };
+    std::vector<Slot> table;
+    uint64_t mask;
+
+    public:
+        PerftTable(int sizeInMb);
+        bool probe(BitBoard key, int depth, uint64_t& nodes) const;
+        void store(BitBoard key, int depth, uint64_t nodes);
+};
+
+struct PerftResult {
+    uint64_t nodes, timeMs;
+};
+
+uint64_t perft(Board& board, int depth, PerftTable* table);
+
+// Divided perft: prints the leaf count below every root move, then the total.
+// Root moves are shared among the threads; hashMb = 0 runs without a table.
+PerftResult runPerft(const Board& board, int depth, int threads, int hashMb, std::ostream& out);
+
+#endif
@@ -0,0 +1,234 @@
+#include <cstring>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "pgn.hpp"
+
+using namespace std;
+
+string PgnGame::getTag(const string& name) const {
+    for (const auto& tag : tags) {
+        if (tag.first == name) return tag.second;
+    }
+    return "";
+}
+
+PgnReader::PgnReader(): data{nullptr}, size{0} {}
+
+PgnReader::~PgnReader() {
+    close();
+}
+
+void PgnReader::close() {
+    if (data) munmap(const_cast<char*>(data), size);
+    data = nullptr;
+    size = 0;
+}
+
+bool PgnReader::open(const string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) < 0 || info.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) return false;
+    madvise(mapped, info.st_size, MADV_SEQUENTIAL);
+    data = static_cast<const char*>(mapped);
+    size = info.st_size;
+    return true;
+}
+
+// first line at or after pos that opens a game
+size_t PgnReader::nextGameStart(size_t pos) const {
+    if (pos == 0) return 0;
+    while (pos < size && data[pos - 1] != '\n') ++pos;
+    while (pos < size) {
+        if (size - pos >= 7 && memcmp(data + pos, "[Event ", 7) == 0) return pos;
+        while (pos < size && data[pos++] != '\n') {}
+    }
+    return size;
+}
+
+static bool isDelimiter(char c) {
+    // strchr would also find the terminator, making a NUL byte a delimiter
+    return isspace(static_cast<unsigned char>(c)) || (c != '\0' && strchr("{}()[];", c));
+}
+
+void PgnReader::readRange(size_t begin, size_t end, const PgnMoveCallback& onMove, const PgnGameCallback& onGame,
+                          PgnStats& stats) const {
+    Board board;
+    PgnGame game;
+    bool started = false, inMoves = false;
+
+    auto finish = [&]() {
+        if (!started) return;
+        if (game.fen.empty()) game.fen = DEFAULT_FEN;
+        ++stats.games;
+        if (!game.error.empty()) ++stats.errors;
+        if (onGame) onGame(game);
+        game = PgnGame{};
+        started = inMoves = false;
+    };
+    auto beginMoves = [&]() {
+        if (inMoves) return;
+        string fen = game.getTag("FEN");
+        game.fen = fen.empty() ? DEFAULT_FEN : fen;
+        if (Board::isValidFen(game.fen)) {
+            board.reset(game.fen);
+        } else {
+            game.error = "FEN";
+            board.reset(DEFAULT_FEN);
+        }
+        started = inMoves = true;
+    };
+
+    size_t pos = begin;
+    while (pos < end) {
+        char c = data[pos];
+        if (isspace(static_cast<unsigned char>(c))) {
+            ++pos;
+        } else if (c == '[') {
+            // tag pair: [Name "value"], a tag after movetext opens the next game
+            if (inMoves) finish();
+            size_t nameStart = ++pos;
+            while (pos < end && !isspace(static_cast<unsigned char>(data[pos])) && data[pos] != '"' && data[pos] != ']') ++pos;
+            string name{data + nameStart, pos - nameStart}, value;
+            while (pos < end && data[pos] != '"' && data[pos] != ']' && data[pos] != '\n') ++pos;
+            if (pos < end && data[pos] == '"') {
+                for (++pos; pos < end && data[pos] != '"' && data[pos] != '\n'; ++pos) {
+                    if (data[pos] == '\\' && pos + 1 < end) ++pos;
+                    value += data[pos];
+                }
+            }
+            while (pos < end && data[pos] != ']' && data[pos] != '\n') ++pos;
+            ++pos;
+            game.tags.emplace_back(name, value);
+            started = true;
+        } else if (c == '{') {
+            while (pos < end && data[pos] != '}') ++pos;
+            ++pos;
+        } else if (c == ';' || (c == '%' && (pos == 0 || data[pos - 1] == '\n'))) {
+            while (pos < end && data[pos] != '\n') ++pos;
+        } else if (c == '(') {
+            // variations nest, and may hold comments with parentheses in them
+            int depth = 0;
+            for (; pos < end; ++pos) {
+                if (data[pos] == '{') {
+                    while (pos < end && data[pos] != '}') ++pos;
+                } else if (data[pos] == '(') {
+                    ++depth;
+                } else if (data[pos] == ')' && --depth == 0) {
+                    break;
+                }
+            }
+            ++pos;
+        } else if (c == ')' || c == ']' || c == '}') {
+            ++pos; // stray closer
+        } else {
+            // a token takes at least one byte, so the scan always advances
+            size_t tokenStart = pos++;
+            while (pos < end && !isDelimiter(data[pos])) ++pos;
+            const char* token = data + tokenStart;
+            size_t length = pos - tokenStart;
+
+            if (c == '$') continue; // NAG
+            if ((length == 3 && (memcmp(token, "1-0", 3) == 0 || memcmp(token, "0-1", 3) == 0)) ||
+                (length == 7 && memcmp(token, "1/2-1/2", 7) == 0) || (length == 1 && c == '*')) {
+                beginMoves();
+                game.result.assign(token, length);
+                finish();
+                continue;
+            }
+            // move numbers, possibly glued to the move: "12.", "12...", "12.Nf3"
+            size_t skip = 0;
+            while (skip < length && isdigit(static_cast<unsigned char>(token[skip]))) ++skip;
+            if (skip < length && token[skip] == '.') {
+                while (skip < length && token[skip] == '.') ++skip;
+            } else {
+                skip = 0;
+            }
+            if (skip == length) continue;
+
+            beginMoves();
+            if (!game.error.empty()) continue;
+            string san{token + skip, length - skip};
+            EncMove move = board.parseSan(san);
+            if (move == NO_MOVE || board.makeMove(move) == ILLEGAL_MOVE) {
+                game.error = san;
+                continue;
+            }
+            game.moves.push_back(move);
+            ++stats.moves;
+            if (onMove) onMove(game, board, move);
+        }
+    }
+    finish();
+}
+
+PgnStats PgnReader::replay(int threads, const PgnMoveCallback& onMove, const PgnGameCallback& onGame) const {
+    uint64_t startTime = getCurrentTimeInMs();
+    threads = max(1, threads);
+    vector<size_t> bounds(threads + 1, size);
+    for (int i = 0; i < threads; ++i) {
+        bounds[i] = nextGameStart(size / threads * i);
+        if (i > 0) bounds[i] = max(bounds[i], bounds[i - 1]);
+    }
+
+    vector<PgnStats> partial(threads, PgnStats{0, 0, 0, 0});
+    vector<thread> workers;
+    for (int i = 1; i < threads; ++i) {
+        workers.emplace_back(&PgnReader::readRange, this, bounds[i], bounds[i + 1], cref(onMove), cref(onGame), ref(partial[i]));
+    }
+    if (data) readRange(bounds[0], bounds[1], onMove, onGame, partial[0]);
+    for (auto& worker : workers) worker.join();
+
+    PgnStats stats{0, 0, 0, 0};
+    for (const PgnStats& part : partial) {
+        stats.games += part.games;
+        stats.moves += part.moves;
+        stats.errors += part.errors;
+    }
+    stats.timeMs = getCurrentTimeInMs() - startTime;
+    return stats;
+}
+
+void writePgn(const PgnGame& game, ostream& out) {
+    string fen = game.fen.empty() ? DEFAULT_FEN : game.fen;
+    for (const auto& tag : game.tags) {
+        out << "[" << tag.first << " \"";
+        for (char c : tag.second) out << (c == '"' || c == '\\' ? "\\" : "") << c;
+        out << "\"]\n";
+    }
+    if (fen != DEFAULT_FEN && game.getTag("FEN").empty()) {
+        out << "[SetUp \"1\"]\n[FEN \"" << fen << "\"]\n";
+    }
+    out << "\n";
+
+    Board board{fen};
+    string line;
+    auto append = [&](const string& token) {
+        if (!line.empty() && line.size() + 1 + token.size() > 80) {
+            out << line << "\n";
+            line.clear();
+        }
+        line += (line.empty() ? "" : " ") + token;
+    };
+    int number = 1;
+    for (size_t i = 0; i < game.moves.size(); ++i) {
+        int side = board.getSide();
+        if (side == WHITE_SIDE) append(to_string(number) + ".");
+        else if (i == 0) append(to_string(number) + "...");
+        append(board.toSan(game.moves[i]));
+        board.makeMove(game.moves[i]);
+        if (side == BLACK_SIDE) ++number;
+    }
+    append(game.result.empty() ? "*" : game.result);
+    out << line << "\n\n";
+}
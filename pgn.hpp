@@ -0,0 +1,61 @@
+#ifndef __PGN_H__
+#define __PGN_H__
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "board.hpp"
+
+struct PgnGame {
+    std::vector<std::pair<std::string, std::string>> tags;
+    std::string fen; // the FEN tag, or the standard start position
+    std::vector<EncMove> moves;
+    std::string result;
+    std::string error; // the first move that failed to resolve, or "FEN"; the game stops there
+
+    std::string getTag(const std::string& name) const;
+};
+
+// Called with the position each move reached (the move already played), and
+// once per finished game. With several threads they run concurrently, one
+// game per thread at a time.
+typedef std::function<void(const PgnGame& game, Board& board, EncMove move)> PgnMoveCallback;
+typedef std::function<void(const PgnGame& game)> PgnGameCallback;
+
+struct PgnStats {
+    uint64_t games, moves, errors;
+    uint64_t timeMs;
+};
+
+// Streaming reader for PGN databases. The file is memory-mapped and
+// tokenized in place: tags, comments, variations, NAGs and move numbers are
+// skipped over without copying, and each SAN move is resolved against a
+// Board with Board::parseSan and played. Threads take contiguous slices of
+// the file, each cut at an "[Event " line, so no game is split; a file
+// without Event tags is read by one thread.
+class PgnReader {
+    const char* data;
+    size_t size;
+
+    void close();
+    size_t nextGameStart(size_t pos) const;
+    void readRange(size_t begin, size_t end, const PgnMoveCallback& onMove, const PgnGameCallback& onGame,
+                   PgnStats& stats) const;
+    public:
+        PgnReader();
+        ~PgnReader();
+        PgnReader(const PgnReader&) = delete;
+        PgnReader& operator=(const PgnReader&) = delete;
+
+        bool open(const std::string& path);
+        PgnStats replay(int threads, const PgnMoveCallback& onMove = PgnMoveCallback(),
+                        const PgnGameCallback& onGame = PgnGameCallback()) const;
+};
+
+// Export format: the game's tags (plus SetUp/FEN for a non-standard start),
+// then SAN movetext wrapped at 80 columns and the result.
+void writePgn(const PgnGame& game, std::ostream& out);
+
+#endif
@@ -0,0 +1,103 @@
+#include "profile.hpp"
+
+#ifdef PROFILE
+
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+const static char* pointNames[PROF_POINTS] = {
+    "makeMove",
+    "undoMove",
+    "generatePseudoMoves",
+    "generateLegalMoves",
+    "generatePawnMoves",
+    "generateKnightMoves",
+    "generateBishopMoves",
+    "generateRookMoves",
+    "generateQueenMoves",
+    "generateKingMoves",
+    "generateSpecialMoves",
+    "isSquareAttacked",
+    "getSquare",
+};
+
+namespace {
+    // histogram bucket i counts calls taking [2^i, 2^(i+1)) cycles
+    struct ProfileBuffer {
+        uint64_t calls[PROF_POINTS];
+        uint64_t cycles[PROF_POINTS];
+        uint64_t histogram[PROF_POINTS][64];
+    };
+
+    // Buffers are never freed, so counts from threads that already exited
+    // still make it into the report.
+    struct Registry {
+        mutex lock;
+        vector<ProfileBuffer*> buffers;
+    };
+    Registry registry;
+
+    struct Reporter {
+        ~Reporter() { profiler::report(cerr); }
+    };
+    Reporter reporter;
+
+    thread_local ProfileBuffer* localBuffer = nullptr;
+
+    ProfileBuffer* registerBuffer() {
+        ProfileBuffer* buffer = new ProfileBuffer();
+        lock_guard<mutex> guard{registry.lock};
+        registry.buffers.push_back(buffer);
+        return buffer;
+    }
+}
+
+void profiler::record(int point, uint64_t cycles) {
+    if (!localBuffer) localBuffer = registerBuffer();
+    ++localBuffer->calls[point];
+    localBuffer->cycles[point] += cycles;
+    ++localBuffer->histogram[point][cycles ? 63 - __builtin_clzll(cycles) : 0];
+}
+
+void profiler::report(ostream& out) {
+    ProfileBuffer total = {};
+    {
+        lock_guard<mutex> guard{registry.lock};
+        for (ProfileBuffer* buffer : registry.buffers) {
+            for (int point = 0; point < PROF_POINTS; ++point) {
+                total.calls[point] += buffer->calls[point];
+                total.cycles[point] += buffer->cycles[point];
+                for (int i = 0; i < 64; ++i) total.histogram[point][i] += buffer->histogram[point][i];
+            }
+        }
+    }
+
+    out << endl << "profile (cycles, inclusive)" << endl;
+    out << left << setw(22) << "function" << right << setw(14) << "calls" << setw(16) << "total" << setw(10) << "mean"
+        << setw(10) << "p50" << setw(10) << "p99" << endl;
+    for (int point = 0; point < PROF_POINTS; ++point) {
+        uint64_t calls = total.calls[point];
+        if (!calls) continue;
+
+        // percentiles are reported as the upper bound of their bucket
+        uint64_t seen = 0, p50 = 0, p99 = 0;
+        for (int i = 0; i < 64; ++i) {
+            seen += total.histogram[point][i];
+            if (!p50 && seen * 2 >= calls) p50 = 2ULL << i;
+            if (!p99 && seen * 100 >= calls * 99) p99 = 2ULL << i;
+        }
+        out << left << setw(22) << pointNames[point] << right << setw(14) << calls << setw(16) << total.cycles[point]
+            << setw(10) << total.cycles[point] / calls << setw(10) << p50 << setw(10) << p99 << endl;
+        out << "    histogram:";
+        for (int i = 0; i < 64; ++i) {
+            if (total.histogram[point][i]) out << " <" << (2ULL << i) << ":" << total.histogram[point][i];
+        }
+        out << endl;
+    }
+}
+
+#endif
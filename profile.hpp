@@ -0,0 +1,66 @@
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+// Hot-path instrumentation, compiled in only with -DPROFILE (make PROFILE_FLAGS=-DPROFILE).
+// PROFILE_SCOPE(point) records the call and its cycle count into a thread-local
+// buffer; all buffers are merged and reported to stderr at exit. Without
+// PROFILE the macro expands to nothing.
+
+enum ProfilePoint {
+    PROF_MAKE_MOVE,
+    PROF_UNDO_MOVE,
+    PROF_GENERATE_PSEUDO_MOVES,
+    PROF_GENERATE_LEGAL_MOVES,
+    PROF_GENERATE_PAWN_MOVES,
+    PROF_GENERATE_KNIGHT_MOVES,
+    PROF_GENERATE_BISHOP_MOVES,
+    PROF_GENERATE_ROOK_MOVES,
+    PROF_GENERATE_QUEEN_MOVES,
+    PROF_GENERATE_KING_MOVES,
+    PROF_GENERATE_SPECIAL_MOVES,
+    PROF_IS_SQUARE_ATTACKED,
+    PROF_GET_SQUARE,
+    PROF_POINTS
+};
+
+#ifdef PROFILE
+
+#include <stdint.h>
+#include <ostream>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+namespace profiler {
+    inline uint64_t readCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+    void record(int point, uint64_t cycles);
+    void report(std::ostream& out);
+}
+
+class ProfileScope {
+    int point;
+    uint64_t start;
+    public:
+        explicit ProfileScope(int point): point{point}, start{profiler::readCycles()} {}
+        ~ProfileScope() { profiler::record(point, profiler::readCycles() - start); }
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(point) ProfileScope PROFILE_CONCAT(profileScope, __LINE__){point}
+
+#else
+
+#define PROFILE_SCOPE(point)
+
+#endif
+
+#endif
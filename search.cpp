@@ -0,0 +1,629 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include "search.hpp"
+#include "bitbase.hpp"
+
+using namespace std;
+
+// indexed by getPieceIndex(piece) % 6
+const static int pieceValue[6] = {100, 320, 330, 500, 900, 20000};
+
+// late move reductions, indexed by [depth][move number]
+namespace {
+    struct ReductionTable {
+        int reductions[64][64];
+        ReductionTable() {
+            for (int depth = 0; depth < 64; ++depth) {
+                for (int moves = 0; moves < 64; ++moves) {
+                    reductions[depth][moves] = depth && moves ? static_cast<int>(0.75 + log(depth) * log(moves) / 2.25) : 0;
+                }
+            }
+        }
+        int get(int depth, int moves) const {
+            return reductions[min(depth, 63)][min(moves, 63)];
+        }
+    };
+    const ReductionTable lmrTable;
+}
+
+static int scoreToTT(int score, int ply) {
+    if (score >= MATE_BOUND) return score + ply;
+    if (score <= -MATE_BOUND) return score - ply;
+    return score;
+}
+
+static int scoreFromTT(int score, int ply) {
+    if (score >= MATE_BOUND) return score - ply;
+    if (score <= -MATE_BOUND) return score + ply;
+    return score;
+}
+
+string scoreToString(int score) {
+    if (score >= MATE_BOUND) return "mate " + to_string((MATE_SCORE - score + 1) / 2);
+    if (score <= -MATE_BOUND) return "mate " + to_string(-(MATE_SCORE + score) / 2);
+    return "cp " + to_string(score);
+}
+
+SearchLimits::SearchLimits():
+    depth{MAX_PLY - 1}, movetime{0}, nodes{0}, time{0}, increment{0}, movesToGo{0}, infinite{false} {}
+
+bool SearchLimits::isBounded() const {
+    return depth < MAX_PLY - 1 || movetime || nodes || time || infinite;
+}
+
+PruningOptions::PruningOptions():
+    nullMove{true}, lmr{true}, reverseFutility{true}, futility{true}, razoring{true},
+    nullMoveReduction{2},
+    lmrMinDepth{3}, lmrMinMoves{3},
+    reverseFutilityDepth{6}, reverseFutilityMargin{90},
+    futilityDepth{3}, futilityMargin{120},
+    razorDepth{2}, razorMargin{250} {}
+
+void PruningOptions::setAll(bool enabled) {
+    nullMove = lmr = reverseFutility = futility = razoring = enabled;
+}
+
+MctsOptions::MctsOptions(): puct{true}, exploration{1.5}, quiescence{4}, reuseTree{true}, arenaMb{64} {}
+
+SearchOptions::SearchOptions():
+    threads{1}, hashMb{16}, showInfo{true}, ponder{false}, multiPv{1}, quietChecks{true}, statsFile{}, hashFile{},
+    numa{NUMA_DEFAULT}, pinThreads{false}, bookFile{}, bookRandoms{}, bookWeighted{true}, bitbases{nullptr}, pruning{}, mcts{} {}
+
+SearchThread::SearchThread(Search& search, int id): search(search), board{}, evaluator{}, counters{}, polls{0}, id{id}, ply{0} {
+    memset(killers, 0, sizeof(killers));
+    memset(history, 0, sizeof(history));
+    memset(pvLength, 0, sizeof(pvLength));
+}
+
+void SearchThread::reset(const Board& position) {
+    board = position;
+    counters.clear();
+    polls = 0;
+    ply = 0;
+    bestMove = NO_MOVE;
+    lines.clear();
+    excluded.clear();
+    bestScore = -INF_SCORE;
+    completedDepth = 0;
+    researches = 0;
+    memset(killers, 0, sizeof(killers));
+    for (auto& row : history) {
+        for (auto& value : row) value /= 8;
+    }
+}
+
+bool SearchThread::shouldStop() {
+    if (search.stopped.load(memory_order_relaxed)) return true;
+    // only the main thread polls the clock, every TIME_CHECK_NODES nodes
+    if (id != 0 || (++polls & (TIME_CHECK_NODES - 1))) return false;
+
+    const SearchLimits& limits = search.limits;
+    if (limits.nodes) {
+        // the same total the info lines report
+        StatsSnapshot snapshot = search.collectStats();
+        if (snapshot.nodes + snapshot.qnodes >= limits.nodes) search.stopped = true;
+    }
+    if (!search.pondering.load(memory_order_acquire) && search.timeManager.hardLimitReached()) search.stopped = true;
+    return search.stopped.load(memory_order_relaxed);
+}
+
+int SearchThread::scoreMove(EncMove encMove, EncMove ttMove) {
+    if (encMove == ttMove) return 1000000;
+
+    Move move{encMove};
+    if (move.isCapture()) {
+        int attacker = getPieceIndex(board.getSquare(move.getSource())) % 6;
+        int victim = move.isEnpassant() ? 0 : getPieceIndex(board.getSquare(move.getTarget())) % 6;
+        return 100000 + pieceValue[victim] * 10 - pieceValue[attacker] / 10;
+    }
+    if (move.isPromotion()) return 90000 + move.getMoveType();
+    if (encMove == killers[ply][0]) return 80000;
+    if (encMove == killers[ply][1]) return 79000;
+    return history[getPieceIndex(board.getSquare(move.getSource()))][move.getTarget()];
+}
+
+void SearchThread::orderMoves(vector<EncMove>& moves, EncMove ttMove) {
+    vector<pair<int, EncMove>> scored;
+    scored.reserve(moves.size());
+    for (EncMove move : moves) scored.push_back({-scoreMove(move, ttMove), move});
+    stable_sort(scored.begin(), scored.end(), [](const pair<int, EncMove>& a, const pair<int, EncMove>& b) {
+        return a.first < b.first;
+    });
+    for (size_t i = 0; i < moves.size(); ++i) moves[i] = scored[i].second;
+}
+
+MovePicker::MovePicker(SearchThread& thread, EncMove ttMove):
+    thread(thread), ttMove{ttMove}, killers{thread.killers[thread.ply][0], thread.killers[thread.ply][1]},
+    stage{STAGE_TT}, killerIndex{0}, captures{}, quiets{}, index{0} {}
+
+bool MovePicker::isKiller(EncMove move) const {
+    return move == killers[0] || move == killers[1];
+}
+
+// selection sort step: the rest of the list is only ordered if it's reached
+EncMove MovePicker::selectBest(vector<pair<int, EncMove>>& moves) {
+    if (index >= moves.size()) return NO_MOVE;
+    size_t best = index;
+    for (size_t i = index + 1; i < moves.size(); ++i) {
+        if (moves[i].first > moves[best].first) best = i;
+    }
+    swap(moves[index], moves[best]);
+    return moves[index++].second;
+}
+
+EncMove MovePicker::next() {
+    Board& board = thread.board;
+    switch (stage) {
+        case STAGE_TT:
+            stage = STAGE_GENERATE;
+            if (board.isPseudoLegal(ttMove)) return ttMove;
+            ttMove = NO_MOVE;
+            // fall through
+        case STAGE_GENERATE:
+            for (EncMove move : board.generatePseudoMoves(board.getSide())) {
+                if (move == ttMove) continue;
+                Move decoded{move};
+                if (decoded.isCapture() || decoded.isPromotion()) {
+                    captures.push_back({thread.scoreMove(move, NO_MOVE), move});
+                } else if (!isKiller(move)) {
+                    quiets.push_back({0, move});
+                }
+            }
+            stage = STAGE_CAPTURES;
+            index = 0;
+            // fall through
+        case STAGE_CAPTURES: {
+            EncMove move = selectBest(captures);
+            if (move != NO_MOVE) return move;
+            stage = STAGE_KILLERS;
+        }
+            // fall through
+        case STAGE_KILLERS:
+            while (killerIndex < 2) {
+                EncMove killer = killers[killerIndex++];
+                if (killer == ttMove || (killerIndex == 2 && killer == killers[0])) continue;
+                if (board.isPseudoLegal(killer) && !Move{killer}.isCapture() && !Move{killer}.isPromotion()) return killer;
+            }
+            for (auto& quiet : quiets) quiet.first = thread.scoreMove(quiet.second, NO_MOVE);
+            stage = STAGE_QUIETS;
+            index = 0;
+            // fall through
+        case STAGE_QUIETS: {
+            EncMove move = selectBest(quiets);
+            if (move != NO_MOVE) return move;
+            stage = STAGE_DONE;
+        }
+            // fall through
+        default:
+            return NO_MOVE;
+    }
+}
+
+void SearchThread::updateQuietStats(EncMove encMove, int depth) {
+    Move move{encMove};
+    if (move.isCapture() || move.isPromotion()) return;
+    if (killers[ply][0] != encMove) {
+        killers[ply][1] = killers[ply][0];
+        killers[ply][0] = encMove;
+    }
+    int& entry = history[getPieceIndex(board.getSquare(move.getSource()))][move.getTarget()];
+    entry = min(entry + depth * depth, 70000);
+}
+
+void SearchThread::updatePv(EncMove move) {
+    pvTable[ply][ply] = move;
+    for (int i = ply + 1; i < pvLength[ply + 1]; ++i) pvTable[ply][i] = pvTable[ply + 1][i];
+    pvLength[ply] = max(pvLength[ply + 1], ply + 1);
+}
+
+bool SearchThread::hasNonPawnMaterial(int side) {
+    const char* pieces = side == WHITE_SIDE ? "NBRQ" : "nbrq";
+    for (int i = 0; i < 4; ++i) {
+        if (board.getPieceBB(pieces[i])) return true;
+    }
+    return false;
+}
+
+int SearchThread::negamax(int depth, int alpha, int beta, bool allowNull) {
+    if (depth <= 0) return quiescence(alpha, beta);
+
+    pvLength[ply] = ply;
+    bool isRoot = ply == 0;
+    bool pvNode = beta - alpha > 1;
+    ++counters.nodes;
+    if (shouldStop()) return 0;
+
+    if (!isRoot) {
+        if (board.getFifty() >= 100 || board.isRepetition()) return 0;
+        if (ply >= MAX_PLY - 1) return evaluator.evaluate(board);
+
+        // mate distance pruning
+        alpha = max(alpha, -MATE_SCORE + ply);
+        beta = min(beta, MATE_SCORE - ply - 1);
+        if (alpha >= beta) return alpha;
+
+        // bitbase hit: exact win/draw, the evaluation still steers towards the mate
+        int result;
+        if (search.options.bitbases && search.options.bitbases->probe(board, result)) {
+            if (result == 0) return 0;
+            int bonus = max(-1000, min(1000, evaluator.evaluate(board)));
+            return result * (BITBASE_WIN_SCORE - ply) + bonus;
+        }
+    }
+
+    int side = board.getSide();
+    bool inCheck = board.isKingInCheck(side);
+    if (inCheck) ++depth;
+
+    BitBoard key = board.getHashKey();
+    TTEntry entry;
+    EncMove ttMove = NO_MOVE;
+    ++counters.ttProbes;
+    if (search.tt.probe(key, entry)) {
+        ++counters.ttHits;
+        ttMove = entry.move;
+        // PV nodes keep searching so the line isn't cut short by a table hit
+        if (!pvNode && entry.depth >= depth) {
+            int score = scoreFromTT(entry.score, ply);
+            if (entry.flag == TT_EXACT ||
+                (entry.flag == TT_LOWER && score >= beta) ||
+                (entry.flag == TT_UPPER && score <= alpha)) {
+                ++counters.ttCutoffs;
+                return score;
+            }
+        }
+    }
+
+    const PruningOptions& pruning = search.options.pruning;
+    int staticEval = inCheck ? -INF_SCORE : evaluator.evaluate(board);
+
+    if (!pvNode && !inCheck && !isRoot) {
+        // reverse futility: far enough above beta that a quiet tree won't fall back
+        if (pruning.reverseFutility && depth <= pruning.reverseFutilityDepth && abs(beta) < MATE_BOUND &&
+            staticEval - pruning.reverseFutilityMargin * depth >= beta) {
+            return staticEval;
+        }
+
+        // razoring: hopeless positions near the horizon only get a capture search
+        if (pruning.razoring && depth <= pruning.razorDepth && staticEval + pruning.razorMargin * depth < alpha) {
+            int score = quiescence(alpha, alpha + 1);
+            if (score <= alpha) return score;
+        }
+
+        // null move: if passing still fails high, a real move will too
+        if (pruning.nullMove && allowNull && depth >= 2 && staticEval >= beta && hasNonPawnMaterial(side)) {
+            int reduction = pruning.nullMoveReduction + depth / 4;
+            board.makeNullMove();
+            ++ply;
+            int score = -negamax(depth - 1 - reduction, -beta, -beta + 1, false);
+            --ply;
+            board.undoNullMove();
+            if (search.stopped.load(memory_order_relaxed)) return 0;
+            if (score >= beta) return score >= MATE_BOUND ? beta : score;
+        }
+    }
+
+    bool futile = pruning.futility && !pvNode && !inCheck && depth <= pruning.futilityDepth &&
+                  staticEval + pruning.futilityMargin * depth <= alpha;
+
+    MovePicker picker{*this, ttMove};
+    CheckInfo checkInfo = board.getCheckInfo();
+    int originalAlpha = alpha, bestScore = -INF_SCORE, legalMoves = 0;
+    EncMove best = NO_MOVE;
+    for (EncMove move = picker.next(); move != NO_MOVE; move = picker.next()) {
+        if (isRoot && find(excluded.begin(), excluded.end(), move) != excluded.end()) continue;
+        Move decoded{move};
+        bool quiet = !decoded.isCapture() && !decoded.isPromotion();
+        bool givesCheck = board.givesCheck(move, checkInfo);
+
+        // futility: quiet moves can't lift a lost-looking node back over alpha
+        if (futile && quiet && !givesCheck && legalMoves > 0) continue;
+
+        if (board.makeMove(move) == ILLEGAL_MOVE) continue;
+        ++legalMoves;
+
+        int reduction = 0;
+        if (pruning.lmr && depth >= pruning.lmrMinDepth && legalMoves > pruning.lmrMinMoves &&
+            quiet && !inCheck && !givesCheck && move != killers[ply][0] && move != killers[ply][1]) {
+            reduction = lmrTable.get(depth, legalMoves) - (pvNode ? 1 : 0);
+            reduction = max(0, min(reduction, depth - 2));
+        }
+
+        // PVS: only the first move gets the full window, the rest must prove
+        // they beat alpha with a zero window before being searched again
+        ++ply;
+        int score;
+        if (legalMoves == 1) {
+            score = -negamax(depth - 1, -beta, -alpha);
+        } else {
+            score = -negamax(depth - 1 - reduction, -alpha - 1, -alpha);
+            if (score > alpha && reduction > 0) score = -negamax(depth - 1, -alpha - 1, -alpha);
+            if (score > alpha && score < beta) score = -negamax(depth - 1, -beta, -alpha);
+        }
+        --ply;
+        board.undoMove();
+        if (search.stopped.load(memory_order_relaxed)) return 0;
+
+        if (score > bestScore) {
+            bestScore = score;
+            best = move;
+            if (score > alpha) {
+                alpha = score;
+                updatePv(move);
+                if (score >= beta) {
+                    ++counters.betaCutoffs;
+                    if (legalMoves == 1) ++counters.firstMoveCutoffs;
+                    updateQuietStats(move, depth);
+                    break;
+                }
+            }
+        }
+    }
+
+    if (legalMoves == 0) return inCheck ? -MATE_SCORE + ply : 0;
+
+    TTFlag flag = bestScore >= beta ? TT_LOWER : (bestScore > originalAlpha ? TT_EXACT : TT_UPPER);
+    // a root with excluded moves doesn't know the position's true score
+    if (!isRoot || excluded.empty()) search.tt.store(key, best, scoreToTT(bestScore, ply), depth, flag);
+    return bestScore;
+}
+
+// Captures and queen promotions, plus quiet checks on the first quiescence
+// ply. A side in check gets no stand pat and must search every evasion.
+int SearchThread::quiescence(int alpha, int beta, int qply) {
+    pvLength[ply] = ply;
+    ++counters.qnodes;
+    if (shouldStop()) return 0;
+
+    int side = board.getSide();
+    bool inCheck = search.options.quietChecks && board.isKingInCheck(side);
+    int standPat = inCheck ? -MATE_SCORE + ply : evaluator.evaluate(board);
+    if (ply >= MAX_PLY - 1) return inCheck ? evaluator.evaluate(board) : standPat;
+    if (standPat >= beta) return standPat;
+    if (standPat > alpha) alpha = standPat;
+
+    vector<EncMove> moves = board.generatePseudoMoves(side);
+    if (!inCheck) {
+        moves.erase(remove_if(moves.begin(), moves.end(), [](EncMove move) {
+            Move decoded{move};
+            return !decoded.isCapture() && decoded.getMoveType() != QUEEN_PROMOTION;
+        }), moves.end());
+        orderMoves(moves, NO_MOVE);
+        if (qply == 0 && search.options.quietChecks) board.generateQuietChecks(side, moves);
+    } else {
+        orderMoves(moves, NO_MOVE);
+    }
+
+    int bestScore = standPat;
+    for (EncMove move : moves) {
+        if (board.makeMove(move) == ILLEGAL_MOVE) continue;
+        ++ply;
+        int score = -quiescence(-beta, -alpha, qply + 1);
+        --ply;
+        board.undoMove();
+        if (search.stopped.load(memory_order_relaxed)) return 0;
+
+        if (score > bestScore) {
+            bestScore = score;
+            if (score > alpha) {
+                alpha = score;
+                if (score >= beta) break;
+            }
+        }
+    }
+    return bestScore;
+}
+
+// Searches a window around the previous score, widening whichever side
+// failed until the score lands inside it.
+int SearchThread::aspirationSearch(int depth, int prevScore) {
+    int delta = ASPIRATION_WINDOW, alpha = -INF_SCORE, beta = INF_SCORE;
+    if (depth >= ASPIRATION_DEPTH && abs(prevScore) < MATE_BOUND) {
+        alpha = max(prevScore - delta, -INF_SCORE);
+        beta = min(prevScore + delta, INF_SCORE);
+    }
+    while (true) {
+        int score = negamax(depth, alpha, beta);
+        if (search.stopped.load(memory_order_relaxed)) return score;
+        if (score <= alpha && alpha > -INF_SCORE) {
+            beta = (alpha + beta) / 2;
+            alpha = max(score - delta, -INF_SCORE);
+        } else if (score >= beta && beta < INF_SCORE) {
+            beta = min(score + delta, INF_SCORE);
+        } else {
+            return score;
+        }
+        ++researches;
+        delta += delta / 2;
+    }
+}
+
+// With MultiPV each iteration searches the root K times, excluding the
+// first moves of the lines already found. Later lines reuse the TT and
+// move ordering of the earlier ones, so they cost far less than a fresh
+// search each.
+void SearchThread::iterativeDeepening() {
+    int rootMoves = static_cast<int>(board.generateLegalMoves(board.getSide()).size());
+    int multiPv = max(1, min(search.options.multiPv, rootMoves));
+
+    // helper threads start one ply deeper on odd ids to desynchronise the trees
+    int depth = 1 + (id & 1);
+    for (; depth <= search.limits.depth; ++depth) {
+        vector<PvLine> found;
+        excluded.clear();
+        researches = 0;
+        for (int pvIndex = 0; pvIndex < multiPv; ++pvIndex) {
+            int prevScore = pvIndex < static_cast<int>(lines.size()) ? lines[pvIndex].score : -INF_SCORE;
+            int score = aspirationSearch(depth, prevScore);
+            if (search.stopped.load(memory_order_relaxed) || pvLength[0] == 0) break;
+            found.push_back({score, vector<EncMove>(pvTable[0], pvTable[0] + pvLength[0])});
+            excluded.push_back(pvTable[0][0]);
+        }
+        excluded.clear();
+        // only fully searched iterations replace the previous lines
+        if (static_cast<int>(found.size()) < multiPv) break;
+
+        stable_sort(found.begin(), found.end(), [](const PvLine& a, const PvLine& b) {
+            return a.score > b.score;
+        });
+        lines = found;
+        bestScore = lines[0].score;
+        bestMove = lines[0].pv[0];
+        completedDepth = depth;
+        if (id == 0) {
+            search.reportIteration(*this);
+            if (!search.pondering.load(memory_order_acquire) && search.timeManager.shouldStopIteration(bestMove, bestScore)) {
+                search.stopped = true;
+            }
+        }
+    }
+}
+
+Search::Search(const SearchOptions& options):
+    options{options}, tt{options.hashMb, options.numa}, threads{}, stopped{false}, pondering{false},
+    root{}, limits{}, timeManager{}, rootMoves{0}, startTime{0}, report{}, progress{} {
+    loadHash(options.hashFile);
+}
+
+void Search::setOptions(const SearchOptions& newOptions) {
+    if (newOptions.hashMb != options.hashMb || newOptions.numa != options.numa) tt.resize(newOptions.hashMb, newOptions.numa);
+    if (newOptions.hashFile != options.hashFile) loadHash(newOptions.hashFile);
+    options = newOptions;
+}
+
+// a snapshot replaces the table whatever the hash option, until it changes
+void Search::loadHash(const string& path) {
+    if (!path.empty() && !tt.load(path)) throw runtime_error("Could not load hash snapshot " + path);
+}
+
+bool Search::saveHash(const string& path) const {
+    return tt.save(path);
+}
+
+void Search::setProgressCallback(ProgressCallback callback) {
+    progress = callback;
+}
+
+const SearchOptions& Search::getOptions() const {
+    return options;
+}
+
+void Search::clear() {
+    tt.clear();
+    threads.clear();
+}
+
+// The opponent played the expected move: the search keeps its tree and
+// only now starts spending its own clock.
+void Search::ponderhit(const SearchLimits& clock) {
+    timeManager.start(clock, getCurrentTimeInMs(), rootMoves);
+    pondering.store(false, memory_order_release);
+}
+
+void Search::stop() {
+    stopped = true;
+}
+
+StatsSnapshot Search::collectStats() const {
+    StatsSnapshot snapshot;
+    for (const auto& thread : threads) snapshot += thread->counters;
+    return snapshot;
+}
+
+void Search::reportIteration(SearchThread& thread) {
+    uint64_t elapsed = getCurrentTimeInMs() - startTime;
+    StatsSnapshot snapshot = collectStats();
+    report.addIteration(thread.completedDepth, thread.bestScore, thread.researches, snapshot, elapsed);
+    uint64_t nodes = snapshot.nodes + snapshot.qnodes;
+    if (progress) progress(SearchProgress{thread.completedDepth, thread.bestScore, nodes, elapsed, thread.lines});
+    if (!options.showInfo) return;
+
+    for (size_t i = 0; i < thread.lines.size(); ++i) {
+        const PvLine& line = thread.lines[i];
+        cout << "info depth " << thread.completedDepth;
+        if (options.multiPv > 1) cout << " multipv " << i + 1;
+        cout << " score " << scoreToString(line.score)
+             << " nodes " << nodes
+             << " nps " << nodes * 1000 / (elapsed ? elapsed : 1)
+             << " time " << elapsed
+             << " hashfull " << tt.hashfull()
+             << " tthit " << static_cast<int>(snapshot.ttHitRate() * 1000) / 10.0
+             << " fmc " << static_cast<int>(snapshot.firstMoveCutoffRate() * 1000) / 10.0
+             << " ebf " << static_cast<int>(report.iterations.back().branchingFactor * 100) / 100.0
+             << " pv";
+        for (EncMove move : line.pv) cout << " " << Move{move}.toString();
+        cout << endl;
+    }
+}
+
+void Search::prepare(const Board& board, const SearchLimits& searchLimits, bool ponder) {
+    root = board;
+    limits = searchLimits;
+    startTime = getCurrentTimeInMs();
+    stopped = false;
+    pondering = ponder;
+    report = SearchReport{};
+
+    rootMoves = 0;
+    if (limits.time) {
+        Board position{board};
+        rootMoves = static_cast<int>(position.generateLegalMoves(position.getSide()).size());
+    }
+    timeManager.start(limits, startTime, rootMoves);
+}
+
+SearchReport Search::run(const Board& board, const SearchLimits& searchLimits) {
+    prepare(board, searchLimits);
+    return run();
+}
+
+// Leaves stopped and pondering as prepare(), stop() and ponderhit() set them,
+// so a stop that arrives before the search starts still ends it at once.
+SearchReport Search::run() {
+    while (static_cast<int>(threads.size()) < options.threads) {
+        threads.emplace_back(new SearchThread{*this, static_cast<int>(threads.size())});
+    }
+    threads.resize(max(options.threads, 1));
+    for (auto& thread : threads) thread->reset(root);
+
+    bool pin = options.pinThreads;
+    vector<thread> helpers;
+    for (size_t i = 1; i < threads.size(); ++i) {
+        helpers.emplace_back([this, i, pin]() {
+            if (pin) pinCurrentThread(i);
+            threads[i]->iterativeDeepening();
+        });
+    }
+    SearchThread& main = *threads[0];
+    if (pin) pinCurrentThread(0);
+    main.iterativeDeepening();
+    stopped = true;
+    pondering = false;
+    for (auto& helper : helpers) helper.join();
+
+    // a search interrupted before finishing depth 1 still has a root move
+    if (main.bestMove == NO_MOVE) {
+        vector<EncMove> legalMoves = main.board.generateLegalMoves(main.board.getSide());
+        if (!legalMoves.empty()) main.bestMove = legalMoves[0];
+        main.lines.assign(1, PvLine{main.bestScore, vector<EncMove>(1, main.bestMove)});
+    }
+
+    report.bestMove = main.bestMove;
+    report.pv = main.lines[0].pv;
+    report.lines = main.lines;
+    report.score = main.bestScore;
+    report.depth = main.completedDepth;
+    report.timeMs = getCurrentTimeInMs() - startTime;
+    report.totals = collectStats();
+
+    if (!options.statsFile.empty()) {
+        ofstream out{options.statsFile, ios::app};
+        report.writeJson(out);
+    }
+    return report;
+}
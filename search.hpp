@@ -0,0 +1,183 @@
+#ifndef __SEARCH_H__
+#define __SEARCH_H__
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "board.hpp"
+#include "eval.hpp"
+#include "stats.hpp"
+#include "timeman.hpp"
+#include "tt.hpp"
+
+#define MAX_PLY 128
+#define INF_SCORE 32001
+#define MATE_SCORE 32000
+#define MATE_BOUND (MATE_SCORE - MAX_PLY)
+#define ASPIRATION_DEPTH 4
+#define ASPIRATION_WINDOW 25
+#define TIME_CHECK_NODES 1024 // power of two
+#define DEFAULT_MOVETIME 10000 // ms for a search given no limit at all
+#define BITBASE_WIN_SCORE 20000 // known win without a mate distance, below MATE_BOUND
+
+class Bitbases;
+
+struct SearchLimits {
+    int depth;
+    uint64_t movetime, nodes; // 0 for no limit; nodes include quiescence nodes
+    uint64_t time, increment; // clock of the side to move, 0 when unclocked
+    int movesToGo;            // moves until the next time control, 0 for sudden death
+    bool infinite;            // without other limits, search until stopped instead of DEFAULT_MOVETIME
+    SearchLimits();
+    bool isBounded() const;   // some limit, or infinite, is set
+};
+
+// Selective search switches and margins (centipawns, scaled by depth).
+struct PruningOptions {
+    bool nullMove, lmr, reverseFutility, futility, razoring;
+    int nullMoveReduction;
+    int lmrMinDepth, lmrMinMoves;
+    int reverseFutilityDepth, reverseFutilityMargin;
+    int futilityDepth, futilityMargin;
+    int razorDepth, razorMargin;
+    PruningOptions();
+    void setAll(bool enabled);
+};
+
+// Settings of the Monte Carlo tree search player; its thread count and
+// info output come from SearchOptions.
+struct MctsOptions {
+    bool puct;          // PUCT with capture, promotion and check priors, else UCT with uniform priors
+    double exploration; // constant of the selection formula
+    int quiescence;     // capture plies resolved at a leaf, 0 for the bare static eval
+    bool reuseTree;     // keep the subtree of the position two plies on
+    int arenaMb;        // node arena; with no node or time limit the search fills it
+    MctsOptions();
+};
+
+struct SearchOptions {
+    int threads, hashMb;
+    bool showInfo;
+    bool ponder; // keep searching the expected reply on the opponent's time
+    int multiPv; // number of best root moves to search and report
+    bool quietChecks; // quiescence also tries quiet checks and answers checks with evasions
+    std::string statsFile; // appends one JSON report per move when set
+    std::string hashFile; // transposition table snapshot the search starts from when set
+    NumaPolicy numa; // placement of the transposition table's pages
+    bool pinThreads; // bind search thread i, the calling thread being 0, to the i-th allowed CPU
+    // Polyglot book consulted by the computer player before searching
+    std::string bookFile, bookRandoms;
+    bool bookWeighted;
+    const Bitbases* bitbases; // probed below the root when set, owned by the caller
+    PruningOptions pruning;
+    MctsOptions mcts;
+    SearchOptions();
+};
+
+// Handed to a progress callback after every completed iteration, on the
+// search's own thread.
+struct SearchProgress {
+    int depth, score;
+    uint64_t nodes, timeMs;
+    std::vector<PvLine> lines;
+};
+typedef std::function<void(const SearchProgress&)> ProgressCallback;
+
+class Search;
+class SearchThread;
+
+// Hands out the moves of a node in stages: the TT move before anything is
+// generated, then captures and promotions, then the killers, then the
+// remaining quiet moves by history. TT moves and killers are validated with
+// Board::isPseudoLegal, so a cutoff by either skips generation or sorting.
+class MovePicker {
+    enum Stage { STAGE_TT, STAGE_GENERATE, STAGE_CAPTURES, STAGE_KILLERS, STAGE_QUIETS, STAGE_DONE };
+    SearchThread& thread;
+    EncMove ttMove, killers[2];
+    int stage, killerIndex;
+    std::vector<std::pair<int, EncMove>> captures, quiets;
+    size_t index;
+
+    EncMove selectBest(std::vector<std::pair<int, EncMove>>& moves);
+    bool isKiller(EncMove move) const;
+    public:
+        MovePicker(SearchThread& thread, EncMove ttMove);
+        EncMove next(); // NO_MOVE once every move was handed out
+};
+
+// One worker of the lazy SMP search: its own board copy, evaluator, move
+// ordering tables and counters, sharing only the transposition table.
+class SearchThread {
+    friend class Search;
+    friend class MovePicker;
+    Search& search;
+    Board board;
+    Evaluator evaluator;
+    SearchCounters counters;
+    uint32_t polls; // shouldStop() calls, from negamax and quiescence alike
+    int id, ply;
+    EncMove killers[MAX_PLY][2];
+    int history[PIECES][BOARD_SIZE];
+    // triangular PV table: row ply holds the best line from that ply onward
+    EncMove pvTable[MAX_PLY][MAX_PLY];
+    int pvLength[MAX_PLY];
+    EncMove bestMove;
+    std::vector<PvLine> lines;       // lines of the last completed iteration
+    std::vector<EncMove> excluded;   // root moves already taken by better lines
+    int bestScore, completedDepth, researches;
+
+    bool shouldStop();
+    int scoreMove(EncMove move, EncMove ttMove);
+    void orderMoves(std::vector<EncMove>& moves, EncMove ttMove);
+    void updateQuietStats(EncMove move, int depth);
+    void updatePv(EncMove move);
+    bool hasNonPawnMaterial(int side);
+    int negamax(int depth, int alpha, int beta, bool allowNull = true);
+    int quiescence(int alpha, int beta, int qply = 0);
+    int aspirationSearch(int depth, int prevScore);
+    void iterativeDeepening();
+    public:
+        SearchThread(Search& search, int id);
+        void reset(const Board& position);
+};
+
+class Search {
+    friend class SearchThread;
+    SearchOptions options;
+    TranspositionTable tt;
+    std::vector<std::unique_ptr<SearchThread>> threads;
+    std::atomic<bool> stopped;
+    // while set the clock is ignored; ponderhit() starts it and clears the flag
+    std::atomic<bool> pondering;
+    Board root;
+    SearchLimits limits;
+    TimeManager timeManager;
+    int rootMoves;
+    uint64_t startTime;
+    SearchReport report;
+    ProgressCallback progress;
+
+    StatsSnapshot collectStats() const;
+    void reportIteration(SearchThread& thread);
+    void loadHash(const std::string& path);
+    public:
+        Search(const SearchOptions& options = SearchOptions());
+        void setOptions(const SearchOptions& options);
+        void setProgressCallback(ProgressCallback callback);
+        const SearchOptions& getOptions() const;
+        // Sets up the next search on the calling thread: stop() and ponderhit()
+        // take effect from here on, even before run() starts on another thread
+        void prepare(const Board& board, const SearchLimits& limits, bool ponder = false);
+        SearchReport run(); // the prepared search
+        SearchReport run(const Board& board, const SearchLimits& limits);
+        void ponderhit(const SearchLimits& clock);
+        void stop();
+        void clear();
+        bool saveHash(const std::string& path) const; // call between searches
+};
+
+std::string scoreToString(int score); // "cp 35" or "mate -3"
+
+#endif
@@ -0,0 +1,369 @@
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "server.hpp"
+
+using namespace std;
+
+#define MAX_EVENTS 256
+#define READ_CHUNK 4096
+#define MAX_LINE 4096 // longer input closes the session
+
+static runtime_error systemError(const string& what) {
+    return runtime_error(what + ": " + strerror(errno));
+}
+
+static const char* terminationName(Termination termination) {
+    switch (termination) {
+        case CHECKMATE: return "checkmate";
+        case STALEMATE: return "stalemate";
+        case FIFTY_MOVE_RULE: return "fifty-move rule";
+        case THREEFOLD_REPETITION: return "threefold repetition";
+        case INSUFFICIENT_MATERIAL: return "insufficient material";
+        default: return "ongoing";
+    }
+}
+
+unique_ptr<Board> BoardPool::acquire(const string& fen) {
+    if (boards.empty()) return unique_ptr<Board>{new Board{fen}};
+    unique_ptr<Board> board = move(boards.back());
+    boards.pop_back();
+    board->reset(fen);
+    return board;
+}
+
+void BoardPool::release(unique_ptr<Board> board) {
+    if (board) boards.push_back(move(board));
+}
+
+size_t BoardPool::available() const {
+    return boards.size();
+}
+
+WorkerPool::WorkerPool(int threads, const SearchOptions& options, int notifyFd):
+    workers{}, jobs{}, results{}, running{}, cancelled{}, mutex{}, ready{}, stopping{false}, notifyFd{notifyFd} {
+    SearchOptions workerOptions = options;
+    workerOptions.threads = 1;
+    workerOptions.showInfo = false;
+    workerOptions.ponder = false;
+    workerOptions.multiPv = 1;
+    workerOptions.statsFile.clear();
+    for (int i = 0; i < threads; ++i) workers.emplace_back(&WorkerPool::work, this, workerOptions);
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+    }
+    ready.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+void WorkerPool::work(SearchOptions options) {
+    Search search{options};
+    while (true) {
+        unique_lock<std::mutex> lock{mutex};
+        ready.wait(lock, [this]() { return stopping || !jobs.empty(); });
+        if (stopping) return;
+        EngineJob job = move(jobs.front());
+        jobs.pop_front();
+        // prepared under the lock, so a cancel either finds it running or marked
+        search.prepare(job.board, job.limits);
+        if (cancelled.erase(job.session)) search.stop();
+        else running[job.session] = &search;
+        lock.unlock();
+
+        SearchReport report = search.run();
+
+        lock.lock();
+        running.erase(job.session);
+        results.push_back(EngineResult{job.fd, job.session, report.bestMove, report.score});
+        lock.unlock();
+        uint64_t one = 1;
+        if (write(notifyFd, &one, sizeof(one)) < 0) {} // only fails if the counter would overflow
+    }
+}
+
+void WorkerPool::submit(EngineJob job) {
+    {
+        lock_guard<std::mutex> lock{mutex};
+        jobs.push_back(move(job));
+    }
+    ready.notify_one();
+}
+
+void WorkerPool::cancel(uint64_t session) {
+    lock_guard<std::mutex> lock{mutex};
+    auto it = running.find(session);
+    if (it != running.end()) {
+        it->second->stop();
+        return;
+    }
+    for (const EngineJob& job : jobs) {
+        if (job.session == session) cancelled.insert(session);
+    }
+}
+
+vector<EngineResult> WorkerPool::collect() {
+    lock_guard<std::mutex> lock{mutex};
+    vector<EngineResult> done;
+    done.swap(results);
+    return done;
+}
+
+GameServer::GameServer(const SearchOptions& options, const SearchLimits& limits, int threads):
+    defaultLimits{limits}, pool{}, sessions{}, epollFd{-1}, listenFd{-1}, notifyFd{-1}, nextSession{0},
+    socketPath{}, workers{} {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) throw systemError("epoll_create1");
+    notifyFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (notifyFd < 0) throw systemError("eventfd");
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = notifyFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, notifyFd, &event);
+    workers.reset(new WorkerPool{max(1, threads), options, notifyFd});
+    if (!defaultLimits.isBounded()) defaultLimits.movetime = SERVER_MOVETIME;
+}
+
+GameServer::~GameServer() {
+    workers.reset();
+    for (auto& entry : sessions) ::close(entry.first);
+    if (listenFd >= 0) ::close(listenFd);
+    if (!socketPath.empty()) unlink(socketPath.c_str());
+    if (notifyFd >= 0) ::close(notifyFd);
+    if (epollFd >= 0) ::close(epollFd);
+}
+
+void GameServer::listen(const string& address) {
+    bool isPort = !address.empty() && address.find_first_not_of("0123456789") == string::npos;
+    if (isPort) {
+        listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) throw systemError("socket");
+        int reuse = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(stoi(address));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) throw systemError("bind " + address);
+    } else {
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) throw systemError("socket");
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (address.size() >= sizeof(addr.sun_path)) throw runtime_error("Socket path too long: " + address);
+        strcpy(addr.sun_path, address.c_str());
+        unlink(address.c_str());
+        if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) throw systemError("bind " + address);
+        socketPath = address;
+    }
+    if (::listen(listenFd, SOMAXCONN) < 0) throw systemError("listen");
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+}
+
+void GameServer::run() {
+    if (listenFd < 0) throw runtime_error("Server is not listening");
+    epoll_event events[MAX_EVENTS];
+    while (true) {
+        int ready = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            throw systemError("epoll_wait");
+        }
+        for (int i = 0; i < ready; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == listenFd) {
+                accept();
+            } else if (fd == notifyFd) {
+                finishSearches();
+            } else {
+                auto it = sessions.find(fd);
+                if (it == sessions.end()) continue;
+                if (events[i].events & EPOLLOUT) flush(fd, it->second);
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) receive(fd, it->second);
+                if (it->second.closing) close(fd);
+            }
+        }
+    }
+}
+
+void GameServer::accept() {
+    while (true) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return; // EAGAIN once the backlog is drained; anything else is the client's loss
+        Session& session = sessions[fd];
+        session.id = ++nextSession;
+        session.board = pool.acquire(DEFAULT_FEN);
+        session.limits = defaultLimits;
+        session.thinking = session.closing = session.writable = false;
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+void GameServer::receive(int fd, Session& session) {
+    char buffer[READ_CHUNK];
+    ssize_t bytes = read(fd, buffer, sizeof(buffer));
+    if (bytes == 0 || (bytes < 0 && errno != EAGAIN && errno != EINTR)) {
+        session.output.clear();
+        session.closing = true;
+        return;
+    }
+    if (bytes < 0) return;
+    session.input.append(buffer, bytes);
+
+    size_t start = 0, end;
+    while (!session.closing && (end = session.input.find('\n', start)) != string::npos) {
+        string line = session.input.substr(start, end - start);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        start = end + 1;
+        handle(fd, session, line);
+    }
+    session.input.erase(0, start);
+    if (session.input.size() > MAX_LINE) {
+        session.output.clear();
+        session.closing = true;
+    }
+}
+
+void GameServer::handle(int fd, Session& session, const string& line) {
+    istringstream ss{line};
+    string command;
+    ss >> command;
+    if (command.empty()) return;
+    if (command == "quit") {
+        session.closing = true;
+        return;
+    }
+    if (command == "stop") {
+        if (!session.thinking) return reply(fd, session, "error not thinking");
+        workers->cancel(session.id);
+        return;
+    }
+    if (session.thinking) {
+        reply(fd, session, "error busy");
+        return;
+    }
+
+    if (command == "new") {
+        string fen;
+        getline(ss >> ws, fen);
+        if (!fen.empty() && !Board::isValidFen(fen)) return reply(fd, session, "error bad fen");
+        session.board->reset(fen.empty() ? DEFAULT_FEN : fen);
+        reply(fd, session, "ok");
+    } else if (command == "move") {
+        if (session.board->getGameStatus().isOver()) return reply(fd, session, "error game over");
+        string source, target;
+        char promote = 'x';
+        ss >> source >> target >> promote;
+        if (session.board->makeMove(source, target, promote) == ILLEGAL_MOVE) return reply(fd, session, "error illegal move");
+        reply(fd, session, "ok");
+        reportStatus(fd, session);
+    } else if (command == "go") {
+        if (session.board->getGameStatus().isOver()) return reply(fd, session, "error game over");
+        session.thinking = true;
+        workers->submit(EngineJob{fd, session.id, *session.board, session.limits});
+    } else if (command == "setoption") {
+        string name, rest;
+        int64_t value;
+        if (!(ss >> name >> value) || value <= 0 || ss >> rest) return reply(fd, session, "error bad value");
+        if (name == "depth") session.limits.depth = value;
+        else if (name == "movetime") session.limits.movetime = value;
+        else if (name == "nodes") session.limits.nodes = value;
+        else return reply(fd, session, "error unknown option " + name);
+        reply(fd, session, "ok");
+    } else {
+        reply(fd, session, "error unknown command " + command);
+    }
+}
+
+void GameServer::reply(int fd, Session& session, const string& line) {
+    bool idle = session.output.empty();
+    session.output += line;
+    session.output += '\n';
+    if (idle) flush(fd, session);
+}
+
+void GameServer::reportStatus(int fd, Session& session) {
+    GameStatus status = session.board->getGameStatus();
+    if (status.isOver()) reply(fd, session, string("gameover ") + terminationName(status.termination));
+}
+
+// Sends what the socket takes now; the rest waits for EPOLLOUT.
+void GameServer::flush(int fd, Session& session) {
+    while (!session.output.empty()) {
+        ssize_t bytes = send(fd, session.output.data(), session.output.size(), MSG_NOSIGNAL);
+        if (bytes < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN) {
+                session.output.clear();
+                session.closing = true;
+            }
+            break;
+        }
+        session.output.erase(0, bytes);
+    }
+    bool writable = !session.output.empty();
+    if (writable != session.writable) {
+        session.writable = writable;
+        watch(fd, writable);
+    }
+}
+
+void GameServer::watch(int fd, bool writable) {
+    epoll_event event{};
+    event.events = writable ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    event.data.fd = fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+}
+
+// The descriptor stays open while a worker still searches for the session,
+// so its number can't be reused by a new connection the result would reach.
+void GameServer::close(int fd) {
+    auto it = sessions.find(fd);
+    if (it == sessions.end()) return;
+    Session& session = it->second;
+    if (session.thinking) workers->cancel(session.id);
+    session.closing = true;
+    if (!session.output.empty()) return;
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    shutdown(fd, SHUT_RDWR);
+    if (session.thinking) return;
+    ::close(fd);
+    pool.release(move(session.board));
+    sessions.erase(it);
+}
+
+void GameServer::finishSearches() {
+    uint64_t count;
+    if (read(notifyFd, &count, sizeof(count)) < 0) {} // EAGAIN when another wakeup already drained it
+    for (const EngineResult& result : workers->collect()) {
+        auto it = sessions.find(result.fd);
+        if (it == sessions.end() || it->second.id != result.session) continue;
+        Session& session = it->second;
+        session.thinking = false;
+        if (session.closing) {
+            close(result.fd);
+            continue;
+        }
+        session.board->makeMove(result.move);
+        reply(result.fd, session, "bestmove " + Move{result.move}.toString() + " score " + scoreToString(result.score));
+        reportStatus(result.fd, session);
+        if (session.closing) close(result.fd);
+    }
+}
@@ -0,0 +1,115 @@
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "board.hpp"
+#include "search.hpp"
+
+#define SERVER_MOVETIME 1000 // ms per move when serve is given no limit
+
+// Boards taken back from finished sessions and handed to new ones, so a busy
+// server reuses their move history and piece maps instead of reallocating.
+class BoardPool {
+    std::vector<std::unique_ptr<Board>> boards;
+    public:
+        std::unique_ptr<Board> acquire(const std::string& fen);
+        void release(std::unique_ptr<Board> board);
+        size_t available() const;
+};
+
+// An engine move wanted by a session, searched on a copy of its board.
+struct EngineJob {
+    int fd;
+    uint64_t session;
+    Board board;
+    SearchLimits limits;
+};
+
+struct EngineResult {
+    int fd;
+    uint64_t session;
+    EncMove move;
+    int score;
+};
+
+// Fixed set of search threads, each with its own Search and transposition
+// table. Finished moves are queued and signalled on an eventfd so the event
+// loop picks them up together with socket readiness.
+class WorkerPool {
+    std::vector<std::thread> workers;
+    std::deque<EngineJob> jobs;
+    std::vector<EngineResult> results;
+    std::unordered_map<uint64_t, Search*> running; // by session
+    std::unordered_set<uint64_t> cancelled;        // sessions whose queued job stops at once
+    std::mutex mutex;
+    std::condition_variable ready;
+    bool stopping;
+    int notifyFd;
+
+    void work(SearchOptions options);
+    public:
+        WorkerPool(int threads, const SearchOptions& options, int notifyFd);
+        ~WorkerPool();
+        void submit(EngineJob job);
+        // the session's search ends early and still reports its best move so far
+        void cancel(uint64_t session);
+        std::vector<EngineResult> collect();
+};
+
+// Hosts many games in one process over a localhost TCP port or a Unix socket.
+// Every connection is a session speaking a line protocol:
+//   new [fen]                 start a game, the start position by default
+//   move <from> <to> [promo]  play a move for the side to move
+//   go                        let the engine play the side to move
+//   stop                      make the engine move now
+//   setoption depth|movetime|nodes <n>  n > 0
+//   quit
+// Replies are "ok", "bestmove <move>", "gameover <reason>" or "error <reason>".
+// A session that quits or disconnects cancels its search. Without any limit
+// from the command line, sessions search SERVER_MOVETIME per move.
+// Sockets are multiplexed with level-triggered epoll on a single thread; only
+// searches leave it.
+class GameServer {
+    struct Session {
+        uint64_t id;
+        std::unique_ptr<Board> board;
+        SearchLimits limits;
+        std::string input, output;
+        bool thinking; // a worker is searching for this session
+        bool closing;  // drop once the output is flushed and no search is left
+        bool writable; // EPOLLOUT is watched while output is pending
+    };
+    SearchLimits defaultLimits;
+    BoardPool pool;
+    std::unordered_map<int, Session> sessions;
+    int epollFd, listenFd, notifyFd;
+    uint64_t nextSession;
+    std::string socketPath;
+    std::unique_ptr<WorkerPool> workers;
+
+    void accept();
+    void receive(int fd, Session& session);
+    void flush(int fd, Session& session);
+    void close(int fd);
+    void watch(int fd, bool writable);
+    void handle(int fd, Session& session, const std::string& line);
+    void reply(int fd, Session& session, const std::string& line);
+    void reportStatus(int fd, Session& session);
+    void finishSearches();
+    public:
+        GameServer(const SearchOptions& options, const SearchLimits& limits, int threads);
+        ~GameServer();
+        // a port number listens on 127.0.0.1, anything else is a Unix socket path
+        void listen(const std::string& address);
+        void run();
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "stats.hpp"
+#include "move.hpp"
+
+using namespace std;
+
+void SearchCounters::clear() {
+    nodes.reset();
+    qnodes.reset();
+    ttProbes.reset();
+    ttHits.reset();
+    ttCutoffs.reset();
+    betaCutoffs.reset();
+    firstMoveCutoffs.reset();
+}
+
+StatsSnapshot::StatsSnapshot():
+    nodes{0}, qnodes{0}, ttProbes{0}, ttHits{0}, ttCutoffs{0}, betaCutoffs{0}, firstMoveCutoffs{0} {}
+
+StatsSnapshot& StatsSnapshot::operator+=(const SearchCounters& counters) {
+    nodes += counters.nodes.get();
+    qnodes += counters.qnodes.get();
+    ttProbes += counters.ttProbes.get();
+    ttHits += counters.ttHits.get();
+    ttCutoffs += counters.ttCutoffs.get();
+    betaCutoffs += counters.betaCutoffs.get();
+    firstMoveCutoffs += counters.firstMoveCutoffs.get();
+    return *this;
+}
+
+double StatsSnapshot::ttHitRate() const {
+    return ttProbes ? static_cast<double>(ttHits) / ttProbes : 0.0;
+}
+
+double StatsSnapshot::firstMoveCutoffRate() const {
+    return betaCutoffs ? static_cast<double>(firstMoveCutoffs) / betaCutoffs : 0.0;
+}
+
+SearchReport::SearchReport(): bestMove{0}, score{0}, depth{0}, timeMs{0} {}
+
+void SearchReport::addIteration(int depth, int score, int researches, const StatsSnapshot& snapshot, uint64_t elapsed) {
+    uint64_t prevNodes = 0, prevTime = 0, prevIterNodes = 0;
+    for (const auto& iteration : iterations) {
+        prevNodes += iteration.nodes;
+        prevTime += iteration.timeMs;
+    }
+    if (!iterations.empty()) prevIterNodes = iterations.back().nodes;
+
+    IterationStats iteration;
+    iteration.depth = depth;
+    iteration.score = score;
+    iteration.nodes = snapshot.nodes + snapshot.qnodes - prevNodes;
+    iteration.timeMs = elapsed - prevTime;
+    iteration.researches = researches;
+    iteration.branchingFactor = prevIterNodes ? static_cast<double>(iteration.nodes) / prevIterNodes : 0.0;
+    iterations.push_back(iteration);
+}
+
+void SearchReport::writeJson(ostream& out) const {
+    out << "{\"bestmove\":\"" << Move{bestMove}.toString() << "\""
+        << ",\"score\":" << score
+        << ",\"depth\":" << depth
+        << ",\"time_ms\":" << timeMs
+        << ",\"nodes\":" << totals.nodes
+        << ",\"qnodes\":" << totals.qnodes
+        << ",\"tt_probes\":" << totals.ttProbes
+        << ",\"tt_hits\":" << totals.ttHits
+        << ",\"tt_cutoffs\":" << totals.ttCutoffs
+        << ",\"beta_cutoffs\":" << totals.betaCutoffs
+        << ",\"first_move_cutoff_rate\":" << totals.firstMoveCutoffRate()
+        << ",\"pv\":[";
+    for (size_t i = 0; i < pv.size(); ++i) out << (i ? "," : "") << "\"" << Move{pv[i]}.toString() << "\"";
+    out << "],\"lines\":[";
+    for (size_t i = 0; i < lines.size(); ++i) {
+        out << (i ? "," : "") << "{\"score\":" << lines[i].score << ",\"pv\":[";
+        for (size_t j = 0; j < lines[i].pv.size(); ++j) {
+            out << (j ? "," : "") << "\"" << Move{lines[i].pv[j]}.toString() << "\"";
+        }
+        out << "]}";
+    }
+    out << "],\"iterations\":[";
+    for (size_t i = 0; i < iterations.size(); ++i) {
+        const IterationStats& iteration = iterations[i];
+        out << (i ? "," : "") << "{\"depth\":" << iteration.depth
+            << ",\"score\":" << iteration.score
+            << ",\"nodes\":" << iteration.nodes
+            << ",\"time_ms\":" << iteration.timeMs
+            << ",\"researches\":" << iteration.researches
+            << ",\"ebf\":" << iteration.branchingFactor << "}";
+    }
+    out << "]}" << endl;
+}
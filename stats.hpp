@@ -0,0 +1,69 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <atomic>
+#include <vector>
+#include <ostream>
+#include "util.hpp"
+
+// Per-thread event counter. Only the owning thread writes it, so an increment
+// is a relaxed load and store rather than a locked read-modify-write; other
+// threads may still read it for progress reports.
+class Counter {
+    std::atomic<uint64_t> value;
+    public:
+        Counter(): value{0} {}
+        void operator++() { value.store(value.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+        void operator+=(uint64_t n) { value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+        uint64_t get() const { return value.load(std::memory_order_relaxed); }
+        void reset() { value.store(0, std::memory_order_relaxed); }
+};
+
+struct SearchCounters {
+    Counter nodes, qnodes;
+    Counter ttProbes, ttHits, ttCutoffs;
+    Counter betaCutoffs, firstMoveCutoffs;
+
+    void clear();
+};
+
+// Plain totals, summed over the counters of every search thread.
+struct StatsSnapshot {
+    uint64_t nodes, qnodes;
+    uint64_t ttProbes, ttHits, ttCutoffs;
+    uint64_t betaCutoffs, firstMoveCutoffs;
+
+    StatsSnapshot();
+    StatsSnapshot& operator+=(const SearchCounters& counters);
+    double ttHitRate() const;
+    double firstMoveCutoffRate() const;
+};
+
+struct IterationStats {
+    int depth, score;
+    uint64_t nodes, timeMs;
+    int researches; // aspiration window failures before the score settled
+    double branchingFactor; // nodes of this iteration over the previous one
+};
+
+// One root line of a (multi-)PV search.
+struct PvLine {
+    int score;
+    std::vector<EncMove> pv;
+};
+
+struct SearchReport {
+    EncMove bestMove;
+    std::vector<EncMove> pv;
+    std::vector<PvLine> lines; // best first; more than one with MultiPV
+    int score, depth;
+    uint64_t timeMs;
+    StatsSnapshot totals;
+    std::vector<IterationStats> iterations;
+
+    SearchReport();
+    void addIteration(int depth, int score, int researches, const StatsSnapshot& snapshot, uint64_t elapsed);
+    void writeJson(std::ostream& out) const;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include <algorithm>
+#include "timeman.hpp"
+#include "search.hpp"
+
+using namespace std;
+
+// soft limit scale by how many iterations in a row kept the same best move
+const static double stabilityScale[] = {1.8, 1.3, 1.0, 0.85, 0.7};
+
+TimeManager::TimeManager():
+    active{false}, adaptive{false}, startTime{0}, softLimit{0}, hardLimit{0},
+    lastBestMove{NO_MOVE}, lastScore{0}, stability{0} {}
+
+void TimeManager::start(const SearchLimits& limits, uint64_t start, int legalMoves) {
+    startTime = start;
+    lastBestMove = NO_MOVE;
+    lastScore = 0;
+    stability = 0;
+    uint64_t movetime = limits.isBounded() ? limits.movetime : DEFAULT_MOVETIME;
+    active = movetime || limits.time;
+    adaptive = !movetime && limits.time;
+
+    if (movetime) {
+        softLimit = hardLimit = movetime;
+        return;
+    }
+    if (!limits.time) return;
+
+    uint64_t available = limits.time > MOVE_OVERHEAD_MS ? limits.time - MOVE_OVERHEAD_MS : 1;
+    uint64_t movesToGo = limits.movesToGo ? limits.movesToGo : DEFAULT_MOVES_TO_GO;
+    uint64_t base = available / movesToGo + limits.increment * 3 / 4;
+
+    hardLimit = min(available * 4 / 5, base * 5);
+    softLimit = min(base, hardLimit);
+    // nothing to think about with a single reply
+    if (legalMoves == 1) softLimit = hardLimit = min<uint64_t>(softLimit, 50);
+    hardLimit = max<uint64_t>(hardLimit, 1);
+}
+
+uint64_t TimeManager::elapsed() const {
+    return getCurrentTimeInMs() - startTime;
+}
+
+bool TimeManager::hardLimitReached() const {
+    return active && elapsed() >= hardLimit;
+}
+
+bool TimeManager::shouldStopIteration(EncMove bestMove, int score) {
+    if (!active) return false;
+
+    stability = bestMove == lastBestMove ? min(stability + 1, 4) : 0;
+    double scale = stabilityScale[stability];
+    // a falling score means the previous choice is in trouble: think longer
+    if (lastBestMove != NO_MOVE && score < lastScore - 60) scale *= 1.6;
+    else if (lastBestMove != NO_MOVE && score < lastScore - 25) scale *= 1.25;
+    lastBestMove = bestMove;
+    lastScore = score;
+
+    if (!adaptive) return elapsed() >= softLimit;
+    // the next iteration usually costs more than all previous ones, so don't
+    // start it past half of the scaled budget
+    uint64_t budget = min(static_cast<uint64_t>(softLimit * scale), hardLimit);
+    return elapsed() >= budget / 2;
+}
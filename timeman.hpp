@@ -0,0 +1,29 @@
+#ifndef __TIMEMAN_H__
+#define __TIMEMAN_H__
+
+#include "util.hpp"
+
+#define DEFAULT_MOVES_TO_GO 30
+#define MOVE_OVERHEAD_MS 30
+
+struct SearchLimits;
+
+// Splits a game clock into a soft limit, checked between iterations and
+// scaled by how settled the search looks, and a hard limit that aborts the
+// search mid-iteration. A fixed movetime uses the same value for both, and
+// a search without any limit gets DEFAULT_MOVETIME.
+class TimeManager {
+    bool active, adaptive;
+    uint64_t startTime, softLimit, hardLimit;
+    EncMove lastBestMove;
+    int lastScore, stability;
+    public:
+        TimeManager();
+        void start(const SearchLimits& limits, uint64_t startTime, int legalMoves);
+        uint64_t elapsed() const;
+        bool hardLimitReached() const;
+        // called after every completed iteration of the main thread
+        bool shouldStopIteration(EncMove bestMove, int score);
+};
+
+#endif
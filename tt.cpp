@@ -0,0 +1,171 @@
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "tt.hpp"
+#include "board.hpp"
+
+using namespace std;
+
+#define TT_MAGIC "CHESSTT1"
+#define TT_VERSION 1
+#define TT_HEADER_SIZE 4096
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version, slotSize;
+    uint64_t slots, fingerprint;
+};
+
+// Snapshots are only valid under the keys they were stored with: a change
+// to the Zobrist seed or to how Board combines the keys gives another value.
+static uint64_t zobristFingerprint() {
+    uint64_t fingerprint = Board{}.getHashKey();
+    for (char piece : string("PNBRQKpnbrqk")) {
+        for (int square = 0; square < BOARD_SIZE; ++square) {
+            fingerprint = fingerprint * 0x100000001B3ULL ^ pieceKey(piece, square);
+        }
+    }
+    fingerprint = fingerprint * 0x100000001B3ULL ^ sideKey();
+    for (int i = 0; i < 16; ++i) fingerprint = fingerprint * 0x100000001B3ULL ^ castlingKey(i);
+    for (int i = 0; i < BOARD_WIDTH; ++i) fingerprint = fingerprint * 0x100000001B3ULL ^ enpassantKey(i);
+    return fingerprint;
+}
+
+// data word layout: move (16) | score (16) | depth (8) | flag (8)
+static uint64_t pack(EncMove move, int score, int depth, TTFlag flag) {
+    return static_cast<uint64_t>(move)
+        | static_cast<uint64_t>(static_cast<uint16_t>(score)) << 16
+        | static_cast<uint64_t>(static_cast<uint8_t>(depth)) << 32
+        | static_cast<uint64_t>(flag) << 40;
+}
+
+TranspositionTable::TranspositionTable(int sizeInMb, NumaPolicy numa):
+    table{nullptr}, slots{0}, mapping{nullptr}, mappingSize{0}, snapshot{false}, mask{0} {
+    resize(sizeInMb, numa);
+}
+
+TranspositionTable::~TranspositionTable() {
+    release();
+}
+
+void TranspositionTable::release() {
+    if (snapshot) munmap(mapping, mappingSize);
+    else freeLarge(mapping);
+    table = nullptr;
+    mapping = nullptr;
+    slots = mappingSize = 0;
+    snapshot = false;
+    mask = 0;
+}
+
+void TranspositionTable::resize(int sizeInMb, NumaPolicy numa) {
+    size_t count = 1;
+    while (count * 2 * sizeof(Slot) <= static_cast<size_t>(sizeInMb) * 1024 * 1024) count *= 2;
+    // fresh pages are zero, which is an empty slot
+    void* mapped = allocateLarge(count * sizeof(Slot), numa);
+    release();
+    mapping = mapped;
+    mappingSize = count * sizeof(Slot);
+    table = static_cast<Slot*>(mapped);
+    slots = count;
+    mask = count - 1;
+}
+
+bool TranspositionTable::load(const string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    SnapshotHeader header;
+    if (fstat(fd, &info) < 0 || info.st_size < TT_HEADER_SIZE ||
+        pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+        close(fd);
+        return false;
+    }
+    bool valid = memcmp(header.magic, TT_MAGIC, 8) == 0 && header.version == TT_VERSION &&
+        header.slotSize == sizeof(Slot) && header.slots > 0 && (header.slots & (header.slots - 1)) == 0 &&
+        static_cast<uint64_t>(info.st_size) == TT_HEADER_SIZE + header.slots * sizeof(Slot) &&
+        header.fingerprint == zobristFingerprint();
+    void* mapped = valid ? mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (mapped == MAP_FAILED) return false;
+
+    release();
+    mapping = mapped;
+    mappingSize = info.st_size;
+    snapshot = true;
+    table = reinterpret_cast<Slot*>(static_cast<char*>(mapped) + TT_HEADER_SIZE);
+    slots = header.slots;
+    mask = slots - 1;
+    return true;
+}
+
+// written next to the target and renamed over it, so a crash mid-save
+// leaves the previous snapshot intact
+bool TranspositionTable::save(const string& path) const {
+    char header[TT_HEADER_SIZE] = {};
+    SnapshotHeader fields;
+    memcpy(fields.magic, TT_MAGIC, 8);
+    fields.version = TT_VERSION;
+    fields.slotSize = sizeof(Slot);
+    fields.slots = slots;
+    fields.fingerprint = zobristFingerprint();
+    memcpy(header, &fields, sizeof(fields));
+
+    string temporary = path + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (!file) return false;
+    bool ok = fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+        fwrite(table, sizeof(Slot), slots, file) == slots;
+    ok = fclose(file) == 0 && ok;
+    if (ok && rename(temporary.c_str(), path.c_str()) == 0) return true;
+    remove(temporary.c_str());
+    return false;
+}
+
+void TranspositionTable::clear() {
+    for (size_t i = 0; i < slots; ++i) {
+        table[i].check.store(0, memory_order_relaxed);
+        table[i].data.store(0, memory_order_relaxed);
+    }
+}
+
+bool TranspositionTable::probe(BitBoard key, TTEntry& entry) const {
+    const Slot& slot = table[key & mask];
+    uint64_t data = slot.data.load(memory_order_relaxed);
+    uint64_t check = slot.check.load(memory_order_relaxed);
+    if ((check ^ data) != key || data == 0) return false;
+
+    entry.move = static_cast<EncMove>(data & 0xffff);
+    entry.score = static_cast<int16_t>((data >> 16) & 0xffff);
+    entry.depth = static_cast<int8_t>((data >> 32) & 0xff);
+    entry.flag = static_cast<TTFlag>((data >> 40) & 0xff);
+    return true;
+}
+
+void TranspositionTable::store(BitBoard key, EncMove move, int score, int depth, TTFlag flag) {
+    Slot& slot = table[key & mask];
+    uint64_t oldData = slot.data.load(memory_order_relaxed);
+    bool sameKey = (slot.check.load(memory_order_relaxed) ^ oldData) == key;
+    if (sameKey && flag != TT_EXACT && depth < static_cast<int8_t>((oldData >> 32) & 0xff)) return;
+    // keep the known best move when re-storing a position without one
+    if (sameKey && move == 0) move = static_cast<EncMove>(oldData & 0xffff);
+
+    uint64_t data = pack(move, score, depth, flag);
+    slot.data.store(data, memory_order_relaxed);
+    slot.check.store(key ^ data, memory_order_relaxed);
+}
+
+int TranspositionTable::hashfull() const {
+    int used = 0, sample = slots < 1000 ? static_cast<int>(slots) : 1000;
+    for (int i = 0; i < sample; ++i) {
+        if (table[i].data.load(memory_order_relaxed) != 0) ++used;
+    }
+    return sample ? used * 1000 / sample : 0;
+}
+
+bool TranspositionTable::usesHugePages() const {
+    return !snapshot && isHugePageBacked(mapping);
+}
@@ -0,0 +1,61 @@
+#ifndef __TT_H__
+#define __TT_H__
+
+#include <atomic>
+#include <string>
+#include "memory.hpp"
+#include "util.hpp"
+
+enum TTFlag {
+    TT_NONE,
+    TT_EXACT,
+    TT_LOWER,
+    TT_UPPER,
+};
+
+struct TTEntry {
+    EncMove move;
+    int score, depth;
+    TTFlag flag;
+};
+
+// Shared between search threads without locks: each slot stores the key
+// xor'ed with its data word, so a torn write simply fails verification.
+//
+// The slots live in their own mapping so a snapshot written by save() can
+// be mapped straight back by load(): a page-sized header ("CHESSTT1",
+// format version, slot size, slot count and a fingerprint of the Zobrist
+// keys) followed by the raw slots. The snapshot is mapped copy-on-write,
+// so only the pages a search touches are read and the file never changes.
+// A fresh table is allocated on huge pages where the system allows it.
+class TranspositionTable {
+    struct Slot {
+        std::atomic<uint64_t> check, data;
+    };
+    Slot* table;
+    size_t slots;
+    void* mapping; // snapshot mapping, else the table's large allocation
+    size_t mappingSize;
+    bool snapshot;
+    uint64_t mask;
+
+    void release();
+    public:
+        TranspositionTable(int sizeInMb = 16, NumaPolicy numa = NUMA_DEFAULT);
+        ~TranspositionTable();
+        TranspositionTable(const TranspositionTable&) = delete;
+        TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+        void resize(int sizeInMb, NumaPolicy numa = NUMA_DEFAULT);
+        // false, and the table untouched, unless the snapshot was written
+        // by this format with the same Zobrist keys; adopts its size
+        bool load(const std::string& path);
+        bool save(const std::string& path) const;
+        void clear();
+        bool probe(BitBoard key, TTEntry& entry) const;
+        void store(BitBoard key, EncMove move, int score, int depth, TTFlag flag);
+        int hashfull() const; // permille of used slots, sampled
+        bool usesHugePages() const;
+};
+
+#endif
@@ -2,6 +2,9 @@
 #include <iostream>
 #include <chrono>
 #include <cstdint>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 void bitutil::setBit(BitBoard& bitboard, int square) {
     bitboard |= (1ULL << square);
@@ -179,4 +182,183 @@ BitBoard helpers::setOccupancy(int index, int bitsCount, BitBoard mask) {
 }
 uint64_t helpers::getCurrentTimeInMs() {
     return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+int helpers::getPieceIndex(char piece) {
+    switch (piece) {
+        case 'P': return 0;
+        case 'N': return 1;
+        case 'B': return 2;
+        case 'R': return 3;
+        case 'Q': return 4;
+        case 'K': return 5;
+        case 'p': return 6;
+        case 'n': return 7;
+        case 'b': return 8;
+        case 'r': return 9;
+        case 'q': return 10;
+        case 'k': return 11;
+    }
+    return -1;
+}
+
+#ifndef __AVX2__
+// Occluded Kogge-Stone fill in one direction. Positive shifts move towards h1,
+// negative shifts towards a8; wrap is the file mask that stops the fill from
+// spilling across the board edge.
+static BitBoard occludedFill(BitBoard gen, BitBoard empty, int shift, BitBoard wrap) {
+    empty &= wrap;
+    if (shift > 0) {
+        gen |= empty & (gen << shift);
+        empty &= (empty << shift);
+        gen |= empty & (gen << (2 * shift));
+        empty &= (empty << (2 * shift));
+        gen |= empty & (gen << (4 * shift));
+        return (gen << shift) & wrap;
+    }
+    shift = -shift;
+    gen |= empty & (gen >> shift);
+    empty &= (empty >> shift);
+    gen |= empty & (gen >> (2 * shift));
+    empty &= (empty >> (2 * shift));
+    gen |= empty & (gen >> (4 * shift));
+    return (gen >> shift) & wrap;
+}
+#else
+// Four directions per call: lane i fills gens[i] along shifts[i] (always the
+// same sign within a call, selected by left) under wraps[i].
+static __m256i occludedFill4(__m256i gen, __m256i empty, __m256i shift, __m256i wrap, bool left) {
+    __m256i shift2 = _mm256_add_epi64(shift, shift);
+    __m256i shift4 = _mm256_add_epi64(shift2, shift2);
+    empty = _mm256_and_si256(empty, wrap);
+    if (left) {
+        gen = _mm256_or_si256(gen, _mm256_and_si256(empty, _mm256_sllv_epi64(gen, shift)));
+        empty = _mm256_and_si256(empty, _mm256_sllv_epi64(empty, shift));
+        gen = _mm256_or_si256(gen, _mm256_and_si256(empty, _mm256_sllv_epi64(gen, shift2)));
+        empty = _mm256_and_si256(empty, _mm256_sllv_epi64(empty, shift2));
+        gen = _mm256_or_si256(gen, _mm256_and_si256(empty, _mm256_sllv_epi64(gen, shift4)));
+        return _mm256_and_si256(_mm256_sllv_epi64(gen, shift), wrap);
+    }
+    gen = _mm256_or_si256(gen, _mm256_and_si256(empty, _mm256_srlv_epi64(gen, shift)));
+    empty = _mm256_and_si256(empty, _mm256_srlv_epi64(empty, shift));
+    gen = _mm256_or_si256(gen, _mm256_and_si256(empty, _mm256_srlv_epi64(gen, shift2)));
+    empty = _mm256_and_si256(empty, _mm256_srlv_epi64(empty, shift2));
+    gen = _mm256_or_si256(gen, _mm256_and_si256(empty, _mm256_srlv_epi64(gen, shift4)));
+    return _mm256_and_si256(_mm256_srlv_epi64(gen, shift), wrap);
+}
+
+static BitBoard horizontalOr(__m256i v) {
+    __m128i x = _mm_or_si128(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    return static_cast<BitBoard>(_mm_cvtsi128_si64(x) | _mm_extract_epi64(x, 1));
+}
+#endif
+
+BitBoard setwise::sliderAttacksSetwise(BitBoard diagonals, BitBoard orthogonals, BitBoard empty) {
+#ifdef __AVX2__
+    // lanes: south, east (orthogonal) and south-east, south-west (diagonal);
+    // the same shifts to the right give north, west, north-west, north-east
+    const __m256i shift = _mm256_setr_epi64x(8, 1, 9, 7);
+    const __m256i wrapLeft = _mm256_setr_epi64x(~0LL, NOT_A_FILE, NOT_A_FILE, NOT_H_FILE);
+    const __m256i wrapRight = _mm256_setr_epi64x(~0LL, NOT_H_FILE, NOT_H_FILE, NOT_A_FILE);
+    __m256i gen = _mm256_setr_epi64x(orthogonals, orthogonals, diagonals, diagonals);
+    __m256i emp = _mm256_set1_epi64x(empty);
+
+    __m256i attacks = _mm256_or_si256(occludedFill4(gen, emp, shift, wrapLeft, true),
+                                      occludedFill4(gen, emp, shift, wrapRight, false));
+    return horizontalOr(attacks);
+#else
+    BitBoard attacks = 0ULL;
+    attacks |= occludedFill(orthogonals, empty, 8, ~0ULL);
+    attacks |= occludedFill(orthogonals, empty, -8, ~0ULL);
+    attacks |= occludedFill(orthogonals, empty, 1, NOT_A_FILE);
+    attacks |= occludedFill(orthogonals, empty, -1, NOT_H_FILE);
+    attacks |= occludedFill(diagonals, empty, 9, NOT_A_FILE);
+    attacks |= occludedFill(diagonals, empty, -9, NOT_H_FILE);
+    attacks |= occludedFill(diagonals, empty, 7, NOT_H_FILE);
+    attacks |= occludedFill(diagonals, empty, -7, NOT_A_FILE);
+    return attacks;
+#endif
+}
+BitBoard setwise::bishopAttacksSetwise(BitBoard bishops, BitBoard empty) {
+    return sliderAttacksSetwise(bishops, 0ULL, empty);
+}
+BitBoard setwise::rookAttacksSetwise(BitBoard rooks, BitBoard empty) {
+    return sliderAttacksSetwise(0ULL, rooks, empty);
+}
+BitBoard setwise::queenAttacksSetwise(BitBoard queens, BitBoard empty) {
+    return sliderAttacksSetwise(queens, queens, empty);
+}
+BitBoard setwise::pawnAttacksSetwise(int side, BitBoard pawns) {
+    if (side == WHITE_SIDE) {
+        return ((pawns >> 7) & NOT_A_FILE) | ((pawns >> 9) & NOT_H_FILE);
+    }
+    return ((pawns << 9) & NOT_A_FILE) | ((pawns << 7) & NOT_H_FILE);
+}
+BitBoard setwise::knightAttacksSetwise(BitBoard knights) {
+    BitBoard attacks = 0ULL;
+    attacks |= (knights >> 17) & NOT_H_FILE;
+    attacks |= (knights >> 15) & NOT_A_FILE;
+    attacks |= (knights << 6) & NOT_HG_FILE;
+    attacks |= (knights << 10) & NOT_AB_FILE;
+    attacks |= (knights << 17) & NOT_A_FILE;
+    attacks |= (knights << 15) & NOT_H_FILE;
+    attacks |= (knights >> 6) & NOT_AB_FILE;
+    attacks |= (knights >> 10) & NOT_HG_FILE;
+    return attacks;
+}
+BitBoard setwise::northFill(BitBoard bitboard) {
+    bitboard |= (bitboard >> 8);
+    bitboard |= (bitboard >> 16);
+    bitboard |= (bitboard >> 32);
+    return bitboard;
+}
+BitBoard setwise::southFill(BitBoard bitboard) {
+    bitboard |= (bitboard << 8);
+    bitboard |= (bitboard << 16);
+    bitboard |= (bitboard << 32);
+    return bitboard;
+}
+BitBoard setwise::fileFill(BitBoard bitboard) {
+    return northFill(bitboard) | southFill(bitboard);
+}
+
+namespace {
+    struct ZobristTable {
+        BitBoard pieces[PIECES][BOARD_SIZE];
+        BitBoard side;
+        BitBoard castling[16];
+        BitBoard enpassant[BOARD_WIDTH];
+
+        ZobristTable() {
+            // xorshift64*, seeded with a constant
+            BitBoard state = 1070372ULL;
+            auto next = [&state]() {
+                state ^= state >> 12;
+                state ^= state << 25;
+                state ^= state >> 27;
+                return state * 2685821657736338717ULL;
+            };
+            for (int piece = 0; piece < PIECES; ++piece) {
+                for (int square = 0; square < BOARD_SIZE; ++square) {
+                    pieces[piece][square] = next();
+                }
+            }
+            side = next();
+            for (int i = 0; i < 16; ++i) castling[i] = next();
+            for (int i = 0; i < BOARD_WIDTH; ++i) enpassant[i] = next();
+        }
+    };
+    const ZobristTable zobristTable;
+}
+
+BitBoard zobrist::pieceKey(char piece, int square) {
+    return zobristTable.pieces[getPieceIndex(piece)][square];
+}
+BitBoard zobrist::sideKey() {
+    return zobristTable.side;
+}
+BitBoard zobrist::castlingKey(int castlingRight) {
+    return zobristTable.castling[castlingRight];
+}
+BitBoard zobrist::enpassantKey(int square) {
+    return zobristTable.enpassant[square % BOARD_WIDTH];
 }
\ No newline at end of file
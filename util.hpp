@@ -15,6 +15,8 @@
 typedef uint16_t EncMove;
 typedef uint64_t BitBoard;
 
+#define NO_MOVE 0 // a8a8, never generated
+
 enum {
     a8, b8, c8, d8, e8, f8, g8, h8,
     a7, b7, c7, d7, e7, f7, g7, h7,
@@ -362,5 +364,30 @@ inline namespace helpers {
     void prettyPrintBB(BitBoard bb);
     BitBoard setOccupancy(int index, int bitsCount, BitBoard mask);
     uint64_t getCurrentTimeInMs();
+    int getPieceIndex(char piece); // index into pieces[], -1 for empty
+}
+
+// Set-wise (Kogge-Stone) sliding attacks: every slider in the given set is
+// filled at once, so the result is the union of all their attack sets.
+// https://www.chessprogramming.org/Kogge-Stone_Algorithm
+inline namespace setwise {
+    BitBoard bishopAttacksSetwise(BitBoard bishops, BitBoard empty);
+    BitBoard rookAttacksSetwise(BitBoard rooks, BitBoard empty);
+    BitBoard queenAttacksSetwise(BitBoard queens, BitBoard empty);
+    BitBoard sliderAttacksSetwise(BitBoard diagonals, BitBoard orthogonals, BitBoard empty);
+    BitBoard pawnAttacksSetwise(int side, BitBoard pawns);
+    BitBoard knightAttacksSetwise(BitBoard knights);
+    BitBoard northFill(BitBoard bitboard); // towards rank 8
+    BitBoard southFill(BitBoard bitboard); // towards rank 1
+    BitBoard fileFill(BitBoard bitboard);
+}
+
+// Zobrist keys, generated once from a fixed seed so hashes are reproducible
+// across runs and builds.
+inline namespace zobrist {
+    BitBoard pieceKey(char piece, int square);
+    BitBoard sideKey();
+    BitBoard castlingKey(int castlingRight);
+    BitBoard enpassantKey(int square);
 }
 #endif
\ No newline at end of file